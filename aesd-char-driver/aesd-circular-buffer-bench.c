@@ -0,0 +1,156 @@
+/**
+ * @file aesd-circular-buffer-bench.c
+ * @brief Userspace microbenchmark of aesd_circular_buffer_find_entry_offset_for_fpos, built from the same
+ * aesd-circular-buffer.c as the driver
+ *
+ * Fills buffers of increasing capacity with entries of random size, checks every lookup against a linear
+ * walk of the entries and reports the average time per lookup of both.
+ *
+ * Build with "make bench", run as ./aesd-circular-buffer-bench [lookups]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "aesd-circular-buffer.h"
+
+#define BENCH_MAX_ENTRY_SIZE 128 // entries are 1 to BENCH_MAX_ENTRY_SIZE bytes
+#define BENCH_DEFAULT_LOOKUPS 1000000
+
+static char bench_data[BENCH_MAX_ENTRY_SIZE];
+
+/**
+ * @return monotonic time in nanoseconds
+ */
+static unsigned long long bench_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Reference lookup, sums the entry sizes from out_offs like the original implementation
+ */
+static struct aesd_buffer_entry *bench_find_linear(struct aesd_circular_buffer *buffer, size_t char_offset,
+                                                   size_t *entry_offset_byte_rtn)
+{
+    size_t total_count = 0;
+    uint32_t index = buffer->out_offs;
+    uint32_t remaining = buffer->count;
+
+    while (remaining > 0)
+    {
+        total_count += buffer->entry[index].size;
+        if (char_offset < total_count)
+        {
+            *entry_offset_byte_rtn = buffer->entry[index].size - (total_count - char_offset);
+            return &buffer->entry[index];
+        }
+        index = (index + 1) & buffer->entry_mask;
+        remaining--;
+    }
+    return NULL;
+}
+
+/**
+ * Time lookups random positions in a full buffer of capacity entries, after wrapping it once
+ * @return 0 when both lookups agree on every position
+ */
+static int bench_run(uint32_t capacity, unsigned long lookups)
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry;
+    uint32_t slots = aesd_circular_buffer_slots(capacity);
+    struct aesd_buffer_entry *entries = calloc(slots, sizeof(struct aesd_buffer_entry));
+    size_t *positions = malloc(lookups * sizeof(size_t));
+    size_t total_size = 0;
+    size_t offset = 0;
+    size_t checksum = 0;
+    unsigned long long start_ns;
+    unsigned long long search_ns;
+    unsigned long long linear_ns;
+    unsigned long linear_lookups = lookups;
+    uint32_t index;
+    struct aesd_buffer_entry *found;
+
+    if (entries == NULL || positions == NULL)
+    {
+        fprintf(stderr, "Allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    aesd_circular_buffer_init_entries(&buffer, entries, slots, capacity);
+    entry.buffptr = bench_data;
+    for (index = 0; index < capacity + capacity / 2; index++)
+    {
+        entry.size = 1 + rand() % BENCH_MAX_ENTRY_SIZE;
+        aesd_circular_buffer_add_entry(&buffer, &entry);
+    }
+    AESD_CIRCULAR_BUFFER_FOREACH(found, &buffer, index)
+    {
+        total_size += found->size;
+    }
+    for (unsigned long i = 0; i < lookups; i++)
+        positions[i] = (((size_t)rand() << 16) ^ rand()) % total_size;
+
+    // the linear walk is O(n), keep its run time bounded on large buffers
+    if (capacity > 1024 && linear_lookups > 10000)
+        linear_lookups = 10000;
+
+    for (unsigned long i = 0; i < linear_lookups; i++)
+    {
+        size_t linear_offset = 0;
+        found = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, positions[i], &offset);
+        if (found != bench_find_linear(&buffer, positions[i], &linear_offset) || offset != linear_offset)
+        {
+            fprintf(stderr, "Mismatch at position %zu of %u entries\n", positions[i], capacity);
+            return -1;
+        }
+    }
+
+    start_ns = bench_now_ns();
+    for (unsigned long i = 0; i < lookups; i++)
+    {
+        found = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, positions[i], &offset);
+        checksum += offset + found->size;
+    }
+    search_ns = bench_now_ns() - start_ns;
+
+    start_ns = bench_now_ns();
+    for (unsigned long i = 0; i < linear_lookups; i++)
+    {
+        found = bench_find_linear(&buffer, positions[i], &offset);
+        checksum += offset + found->size;
+    }
+    linear_ns = bench_now_ns() - start_ns;
+
+    printf("%10u entries %12zu bytes   search %8.1f ns/lookup   linear %12.1f ns/lookup   (checksum %zu)\n",
+           capacity, total_size, (double)search_ns / lookups, (double)linear_ns / linear_lookups, checksum);
+    free(positions);
+    free(entries);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t capacities[] = {AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, 100, 1000, 10000, 100000,
+                                          AESDCHAR_MAX_ENTRIES_LIMIT};
+    unsigned long lookups = BENCH_DEFAULT_LOOKUPS;
+
+    if (argc > 1)
+        lookups = strtoul(argv[1], NULL, 10);
+    if (lookups == 0)
+    {
+        fprintf(stderr, "Usage: %s [lookups]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    memset(bench_data, 'a', sizeof(bench_data));
+    srand(1);
+    for (size_t i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++)
+    {
+        if (bench_run(capacities[i], lookups) != 0)
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
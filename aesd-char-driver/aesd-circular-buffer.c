@@ -30,29 +30,48 @@ struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct
                                                                           size_t char_offset, size_t *entry_offset_byte_rtn)
 {
 
-    size_t total_count = 0;                // total count of all packets from entry point
-    size_t size_entry = 0;                 // size of the current index packet
-    uint8_t temp_index = buffer->out_offs; // position of read index
-                                           // To check if buffer is empty
-    if ((buffer->full == false) && (buffer->in_offs == buffer->out_offs))
+    uint32_t low = 0;                                              // first candidate, counted from out_offs
+    uint32_t high = buffer->count - 1;                             // last candidate, counted from out_offs
+    size_t base_offs = buffer->entry[buffer->out_offs].start_offs; // start_offs of the oldest entry
+    struct aesd_buffer_entry *entry = NULL;
+    // To check if buffer is empty or the position is past the last entry
+    if (buffer->count == 0 || char_offset >= buffer->end_offs - base_offs)
     {
         return NULL;
     }
-    while (1)
+    // find the last entry starting at or before char_offset
+    while (low < high)
     {
-        size_entry = buffer->entry[temp_index].size; // size of current index
-        total_count += size_entry;                   // total size
-        if (char_offset <= (total_count - 1))        // check if within the total count
-        {
-            *entry_offset_byte_rtn = (size_entry) - (total_count - char_offset); // check for no of bytes inside current packet
-            return &buffer->entry[temp_index];                                   // return the index address
-        }
-        temp_index++;
-        temp_index = temp_index % (AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED);
-        if (temp_index == buffer->in_offs) // read until both input and output index coincide
-            break;
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (buffer->entry[(buffer->out_offs + mid) & buffer->entry_mask].start_offs - base_offs <= char_offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    entry = &buffer->entry[(buffer->out_offs + low) & buffer->entry_mask];
+    *entry_offset_byte_rtn = char_offset - (entry->start_offs - base_offs); // check for no of bytes inside current packet
+    return entry;
+}
+
+/**
+ * @param buffer the buffer holding the entry.  Any necessary locking must be performed by caller.
+ * @param entry_index the index of the entry counted from the oldest entry held, 0 for the oldest
+ * @param entry_start_rtn is a pointer specifying a location to store the position of the first byte of the
+ *      returned entry if all buffer strings were concatenated end to end.  Only set when the entry exists.
+ * @return the struct aesd_buffer_entry at entry_index, or NULL if the buffer holds fewer entries
+ */
+struct aesd_buffer_entry *aesd_circular_buffer_entry_at(struct aesd_circular_buffer *buffer, uint32_t entry_index,
+                                                        size_t *entry_start_rtn)
+{
+    struct aesd_buffer_entry *entry = NULL;
+    if (entry_index >= buffer->count)
+    {
+        return NULL;
     }
-    return NULL;
+    entry = &buffer->entry[(buffer->out_offs + entry_index) & buffer->entry_mask];
+    // start_offs are prefix sums, the difference to the oldest entry is the position
+    *entry_start_rtn = entry->start_offs - buffer->entry[buffer->out_offs].start_offs;
+    return entry;
 }
 
 /**
@@ -65,33 +84,48 @@ struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct
 const char *aesd_circular_buffer_add_entry(struct aesd_circular_buffer *buffer, const struct aesd_buffer_entry *add_entry)
 {
     const char *ptr = NULL;
-    if ((buffer->in_offs == buffer->out_offs) && buffer->full == true) // checking for full condition and overwrite data
+    if (buffer->count == buffer->capacity) // checking for full condition and overwrite data
     {
-        ptr = buffer->entry[buffer->in_offs].buffptr;                                    // store location before over writing
-        buffer->entry[buffer->in_offs] = *(add_entry);                                   // adding data by overwriting
-        buffer->in_offs++;                                                               // incrementing input position
-        buffer->in_offs = (buffer->in_offs) % (AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED); // looping circular buffer
-        buffer->out_offs = buffer->in_offs;                                              // will be in same position
-    }
-    else
-    {
-        buffer->entry[buffer->in_offs] = *(add_entry);
-        buffer->in_offs++;
-        buffer->in_offs = (buffer->in_offs) % (AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED); // looping circular buffer
-        if (buffer->in_offs == buffer->out_offs)                                         // checking for full condition and setting flag
-        {
-            buffer->full = true;
-        }
-        else
-            buffer->full = false;
+        ptr = buffer->entry[buffer->out_offs].buffptr;                  // store location before over writing
+        buffer->total_size -= buffer->entry[buffer->out_offs].size;
+        buffer->entry[buffer->out_offs].buffptr = NULL;                 // the slot is free until the ring comes back to it
+        buffer->entry[buffer->out_offs].size = 0;
+        buffer->entry[buffer->out_offs].start_offs = 0;
+        buffer->out_offs = (buffer->out_offs + 1) & buffer->entry_mask; // oldest entry dropped
+        buffer->count--;
     }
+    buffer->entry[buffer->in_offs] = *(add_entry);
+    buffer->entry[buffer->in_offs].start_offs = buffer->end_offs; // running prefix sum of the entry sizes
+    buffer->end_offs += add_entry->size;
+    buffer->total_size += add_entry->size;
+    buffer->in_offs = (buffer->in_offs + 1) & buffer->entry_mask; // looping circular buffer
+    buffer->count++;
+    buffer->full = (buffer->count == buffer->capacity); // checking for full condition and setting flag
     return ptr;
 }
 
 /**
- * Initializes the circular buffer described by @param buffer to an empty struct
+ * Initializes the circular buffer described by @param buffer to an empty struct holding up to
+ * AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED entries in its embedded array
  */
 void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer)
 {
     memset(buffer, 0, sizeof(struct aesd_circular_buffer));
+    buffer->entry = buffer->default_entry;
+    buffer->entry_mask = AESDCHAR_DEFAULT_ENTRY_SLOTS - 1;
+    buffer->capacity = AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+}
+
+/**
+ * Initializes the circular buffer described by @param buffer to an empty struct holding up to @param capacity
+ * entries in @param entry, an array of @param slots zeroed elements allocated by the caller.
+ * @param slots must be a power of two not smaller than @param capacity, see aesd_circular_buffer_slots()
+ */
+void aesd_circular_buffer_init_entries(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *entry,
+                                       uint32_t slots, uint32_t capacity)
+{
+    memset(buffer, 0, sizeof(struct aesd_circular_buffer));
+    buffer->entry = entry;
+    buffer->entry_mask = slots - 1;
+    buffer->capacity = capacity;
 }
@@ -17,6 +17,14 @@
 #endif
 
 #define AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED 10
+/**
+ * Slots of the array embedded in the buffer, AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED rounded up to a power of two
+ */
+#define AESDCHAR_DEFAULT_ENTRY_SLOTS 16
+/**
+ * Upper bound of the capacity accepted by aesd_circular_buffer_init_entries
+ */
+#define AESDCHAR_MAX_ENTRIES_LIMIT (1U << 20)
 
 struct aesd_buffer_entry
 {
@@ -28,27 +36,57 @@ struct aesd_buffer_entry
      * Number of bytes stored in buffptr
      */
     size_t size;
+    /**
+     * Bytes added to the buffer before this entry since init, set by aesd_circular_buffer_add_entry.
+     * Increases from out_offs to in_offs, so a position is found by binary search
+     */
+    size_t start_offs;
 };
 
 struct aesd_circular_buffer
 {
     /**
-     * An array of pointers to memory allocated for the most recent write operations
+     * An array of pointers to memory allocated for the most recent write operations,
+     * entry_mask + 1 slots long
      */
-    struct aesd_buffer_entry  entry[AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED];
+    struct aesd_buffer_entry *entry;
+    /**
+     * Number of slots minus one, the slot count is a power of two so wrapping an index is a mask
+     */
+    uint32_t entry_mask;
+    /**
+     * Maximum number of entries held, the oldest entry is overwritten beyond it
+     */
+    uint32_t capacity;
+    /**
+     * Number of entries currently held
+     */
+    uint32_t count;
     /**
      * The current location in the entry structure where the next write should
      * be stored.
      */
-    uint8_t in_offs;
+    uint32_t in_offs;
     /**
      * The first location in the entry structure to read from
      */
-    uint8_t out_offs;
+    uint32_t out_offs;
+    /**
+     * Bytes added to the buffer since init, start_offs of the next entry
+     */
+    size_t end_offs;
+    /**
+     * Sum of the sizes of the entries currently held, maintained by aesd_circular_buffer_add_entry
+     */
+    size_t total_size;
     /**
      * set to true when the buffer entry structure is full
      */
     bool full;
+    /**
+     * Slots used by aesd_circular_buffer_init, larger buffers bring their own array
+     */
+    struct aesd_buffer_entry default_entry[AESDCHAR_DEFAULT_ENTRY_SLOTS];
 };
 
 extern struct aesd_buffer_entry *aesd_circular_buffer_find_entry_offset_for_fpos(struct aesd_circular_buffer *buffer,
@@ -58,14 +96,32 @@ extern const char* aesd_circular_buffer_add_entry(struct aesd_circular_buffer *b
 
 extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
 
+extern void aesd_circular_buffer_init_entries(struct aesd_circular_buffer *buffer, struct aesd_buffer_entry *entry,
+            uint32_t slots, uint32_t capacity);
+
+extern struct aesd_buffer_entry *aesd_circular_buffer_entry_at(struct aesd_circular_buffer *buffer, uint32_t entry_index,
+            size_t *entry_start_rtn);
+
+/**
+ * @return the number of slots to allocate for @param capacity entries, the capacity rounded up to a power of two
+ */
+static inline uint32_t aesd_circular_buffer_slots(uint32_t capacity)
+{
+    uint32_t slots = 1;
+
+    while (slots < capacity)
+        slots <<= 1;
+    return slots;
+}
+
 /**
- * Create a for loop to iterate over each member of the circular buffer.
+ * Create a for loop to iterate over each slot of the circular buffer.
  * Useful when you've allocated memory for circular buffer entries and need to free it
  * @param entryptr is a struct aesd_buffer_entry* to set with the current entry
  * @param buffer is the struct aesd_buffer * describing the buffer
- * @param index is a uint8_t stack allocated value used by this macro for an index
+ * @param index is a uint32_t stack allocated value used by this macro for an index
  * Example usage:
- * uint8_t index;
+ * uint32_t index;
  * struct aesd_circular_buffer buffer;
  * struct aesd_buffer_entry *entry;
  * AESD_CIRCULAR_BUFFER_FOREACH(entry,&buffer,index) {
@@ -74,8 +130,8 @@ extern void aesd_circular_buffer_init(struct aesd_circular_buffer *buffer);
  */
 #define AESD_CIRCULAR_BUFFER_FOREACH(entryptr,buffer,index) \
     for(index=0, entryptr=&((buffer)->entry[index]); \
-            index<AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; \
-            index++, entryptr=&((buffer)->entry[index]))
+            index<=(buffer)->entry_mask; \
+            index++, entryptr=&((buffer)->entry[index & (buffer)->entry_mask]))
 
 
 
@@ -38,9 +38,113 @@ struct aesd_seekto {
 
 // Define a write command from the user point of view, use command number 1
 #define AESDCHAR_IOCSEEKTO _IOWR(AESD_IOC_MAGIC, 1, struct aesd_seekto)
+// Nonzero makes reads of this open file at the end of the history wait for the next write instead of
+// returning 0, unless it was opened O_NONBLOCK which gets EAGAIN. Zero restores end of file reads
+#define AESDCHAR_IOCWAIT _IOW(AESD_IOC_MAGIC, 2, uint32_t)
+/**
+ * One command of an AESDCHAR_IOCWRITEV batch, handled like the buffer of one write() call
+ */
+struct aesd_write_vec {
+    /**
+     * User address of the bytes to write
+     */
+    uint64_t buf;
+    /**
+     * Number of bytes at buf
+     */
+    uint64_t len;
+};
+
+/**
+ * A batch of commands for AESDCHAR_IOCWRITEV, the completed ones are inserted with one acquisition
+ * of the buffer lock. The ioctl returns the bytes written like write() and stops at the first
+ * command it could not write completely
+ */
+struct aesd_write_batch {
+    /**
+     * User address of an array of count struct aesd_write_vec
+     */
+    uint64_t vec;
+    /**
+     * Number of commands, at most AESDCHAR_WRITEV_MAX
+     */
+    uint32_t count;
+    uint32_t reserved;
+};
+#define AESDCHAR_WRITEV_MAX 1024
+
+// Write a batch of commands, use command number 3.
+// Like write(), a buffer holding a \n becomes one entry as a whole, "a\nb\n" gives a single entry.
+// writev() and io_uring writes go through write_iter instead, which ends an entry at every \n, so
+// the same bytes give two entries there. Buffers ending in their only \n give the same history
+// through all three
+#define AESDCHAR_IOCWRITEV _IOW(AESD_IOC_MAGIC, 3, struct aesd_write_batch)
 /**
  * The maximum number of commands supported, used for bounds checking
  */
-#define AESDCHAR_IOC_MAXNR 1
+#define AESDCHAR_IOC_MAXNR 3
+
+/**
+ * Layout of the read-only mapping of an aesd char device, mmap it from offset 0.
+ * The mapping starts with this header and its entry table, followed at header_size by a ring of
+ * data_size bytes holding the most recent history. The ring is mapped twice in a row, so data_size
+ * bytes starting anywhere in the first copy are contiguous.
+ *
+ * Positions count the bytes ever written to the device, the byte at position pos is at
+ * header_size + (pos & (data_size - 1)) and file position f corresponds to position start + f.
+ * The ring holds positions max(start, end - data_size) to end.
+ *
+ * The driver makes sequence odd while it updates the mapping. Readers take a consistent snapshot
+ * by reading sequence, the fields, then sequence again, and retrying while it was odd or changed.
+ */
+#define AESDCHAR_MMAP_MAGIC 0x44534541 // "AESD"
+
+struct aesd_mmap_entry {
+    /**
+     * Position of the first byte of the write
+     */
+    uint64_t start;
+    /**
+     * Number of bytes of the write
+     */
+    uint64_t size;
+};
+
+struct aesd_mmap_header {
+    uint32_t magic;
+    /**
+     * Bytes before the data ring, a multiple of the page size
+     */
+    uint32_t header_size;
+    /**
+     * Bytes of the data ring, a power of two
+     */
+    uint64_t data_size;
+    /**
+     * Odd while the driver updates the mapping
+     */
+    uint64_t sequence;
+    /**
+     * Position of the oldest byte held by the device
+     */
+    uint64_t start;
+    /**
+     * Position following the newest byte
+     */
+    uint64_t end;
+    /**
+     * Number of the oldest write held, writes are numbered from 0 since the module was loaded
+     */
+    uint64_t first_entry;
+    /**
+     * Number of writes held
+     */
+    uint32_t entry_count;
+    /**
+     * Write number n is described by entries[n & entry_mask]
+     */
+    uint32_t entry_mask;
+    struct aesd_mmap_entry entries[];
+};
 
 #endif /* AESD_IOCTL_H */
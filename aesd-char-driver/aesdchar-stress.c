@@ -0,0 +1,183 @@
+/**
+ * @file aesdchar-stress.c
+ * @brief Reader scaling stress test of the loaded aesdchar driver
+ *
+ * Runs 1, 2, 4 ... up to the number of online CPUs reader threads, each reading the whole device from
+ * the start again and again, while one writer keeps adding entries. Reports whole-device reads per
+ * second per run and the speed up over a single reader, readers sharing the buffer lock should scale
+ * with the cores until the memory bandwidth runs out.
+ *
+ * Build with "make bench", run as root after aesdchar_load:
+ * ./aesdchar-stress [-d device] [-s seconds per run] [-n no writer]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define STRESS_READ_SIZE (64 * 1024)
+#define STRESS_WRITE_INTERVAL_US 1000
+
+static const char *stress_device = "/dev/aesdchar";
+static atomic_bool stress_running;
+
+struct stress_reader
+{
+    pthread_t thread;
+    unsigned long passes; // whole-device reads completed
+    unsigned long long bytes;
+};
+
+/**
+ * Reader thread, reads the device from offset 0 to end of file until stopped
+ */
+static void *stress_reader_thread(void *arg)
+{
+    struct stress_reader *reader = arg;
+    char *buff = malloc(STRESS_READ_SIZE);
+    int fd = open(stress_device, O_RDONLY);
+
+    if (fd == -1 || buff == NULL)
+    {
+        fprintf(stderr, "Opening %s failed: %s\n", stress_device, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    while (atomic_load(&stress_running))
+    {
+        off_t offset = 0;
+        ssize_t ret;
+
+        while ((ret = pread(fd, buff, STRESS_READ_SIZE, offset)) > 0)
+        {
+            offset += ret;
+            reader->bytes += ret;
+        }
+        if (ret == -1 && errno != EINTR)
+        {
+            fprintf(stderr, "Reading %s failed: %s\n", stress_device, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        reader->passes++;
+    }
+    close(fd);
+    free(buff);
+    return NULL;
+}
+
+/**
+ * Writer thread, adds one newline terminated entry every STRESS_WRITE_INTERVAL_US
+ */
+static void *stress_writer_thread(void *arg)
+{
+    char line[64];
+    unsigned long count = 0;
+    int fd = open(stress_device, O_WRONLY);
+
+    if (fd == -1)
+    {
+        fprintf(stderr, "Opening %s failed: %s\n", stress_device, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    while (atomic_load(&stress_running))
+    {
+        int len = snprintf(line, sizeof(line), "aesdchar-stress write %lu\n", count++);
+        if (write(fd, line, len) != len)
+        {
+            fprintf(stderr, "Writing %s failed: %s\n", stress_device, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        usleep(STRESS_WRITE_INTERVAL_US);
+    }
+    close(fd);
+    return NULL;
+}
+
+/**
+ * Run readers reader threads for seconds
+ * @return whole-device reads per second
+ */
+static double stress_run(int readers, int seconds, bool writer)
+{
+    struct stress_reader *reader = calloc(readers, sizeof(struct stress_reader));
+    pthread_t writer_thread;
+    struct timespec start, end;
+    unsigned long passes = 0;
+    unsigned long long bytes = 0;
+    double elapsed;
+
+    if (reader == NULL)
+    {
+        fprintf(stderr, "Allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    atomic_store(&stress_running, true);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (writer)
+        pthread_create(&writer_thread, NULL, stress_writer_thread, NULL);
+    for (int i = 0; i < readers; i++)
+        pthread_create(&reader[i].thread, NULL, stress_reader_thread, &reader[i]);
+    sleep(seconds);
+    atomic_store(&stress_running, false);
+    for (int i = 0; i < readers; i++)
+    {
+        pthread_join(reader[i].thread, NULL);
+        passes += reader[i].passes;
+        bytes += reader[i].bytes;
+    }
+    if (writer)
+        pthread_join(writer_thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%4d readers  %12.0f device reads/s  %10.1f MB/s", readers, passes / elapsed, bytes / elapsed / 1e6);
+    free(reader);
+    return passes / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = 2;
+    bool writer = true;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double single = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:n")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            stress_device = optarg;
+            break;
+        case 's':
+            seconds = atoi(optarg);
+            break;
+        case 'n':
+            writer = false;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d device] [-s seconds per run] [-n]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (seconds <= 0 || cpus <= 0)
+    {
+        fprintf(stderr, "Invalid run time\n");
+        return EXIT_FAILURE;
+    }
+    for (int readers = 1; readers <= cpus; readers *= 2)
+    {
+        double rate = stress_run(readers, seconds, writer);
+        if (readers == 1)
+            single = rate;
+        printf("  speed up %.2f\n", (single > 0) ? rate / single : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
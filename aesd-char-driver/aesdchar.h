@@ -23,15 +23,51 @@
 #define PDEBUG(fmt, args...) /* not debugging: nothing */
 #endif
 
+/*
+ * Storage of an entry or of a piece of a partial write. Objects of AESD_CHUNK_SIZE come from a
+ * dedicated kmem_cache, longer writes get one kvmalloc'd chunk sized for them
+ */
+#define AESD_CHUNK_SIZE 128
+struct aesd_chunk
+{
+     struct aesd_chunk *next; /*following piece of a partial write*/
+     size_t capacity;         /*bytes available in data*/
+     size_t len;              /*bytes of data in use*/
+     char data[];
+};
+#define AESD_CHUNK_DATA_SIZE (AESD_CHUNK_SIZE - sizeof(struct aesd_chunk))
+
+#define AESD_MAX_DEVS 256 /* upper bound of the aesd_nr_devs module parameter */
+
 struct aesd_dev
 {
      /**
       * TODO: Add structure(s) and locks needed to complete assignment requirements
       */
-     struct aesd_circular_buffer circle_buff;    /*buffer structure */
-     struct aesd_buffer_entry circle_buff_entry; /*buffer entry*/
-     struct mutex lock;
+     struct aesd_circular_buffer circle_buff;    /*buffer structure, protected by buffer_lock */
+     struct mutex lock;                          /*serializes writers adding an entry and updating the mapping*/
+     struct rw_semaphore buffer_lock;            /*readers share it, a writer takes it only to add an entry*/
+     struct aesd_mmap_header *mmap_header;       /*vmalloc_user area mapped by aesd_mmap, updated by writers*/
+     wait_queue_head_t read_queue;               /*readers waiting for the next entry, woken by every completed write*/
+     struct aesd_chunk *leftover_head;           /*unterminated writes of released files, protected by lock*/
+     struct aesd_chunk *leftover_tail;           /*chunk the next write appends to once a file takes them over*/
+     size_t leftover_size;                       /*bytes of the leftover writes*/
      struct cdev cdev; /* Char device structure		*/
 };
 
+/*
+ * State of one open file, kept in filp->private_data
+ */
+struct aesd_file_ctx
+{
+     struct aesd_dev *dev;            /*device the file was opened on*/
+     struct aesd_chunk *partial_head; /*partial write of this file, protected by lock*/
+     struct aesd_chunk *partial_tail; /*chunk the next write appends to*/
+     size_t partial_size;             /*bytes of the partial write*/
+     struct mutex lock;               /*serializes writes through this file*/
+     bool wait;                       /*reads at the end of the history wait for the next entry, set by AESDCHAR_IOCWAIT*/
+     bool stream_valid;               /*stream_pos matches f_pos, cleared by seeks*/
+     size_t stream_pos;               /*f_pos counted from the first byte ever written, so it survives evictions*/
+};
+
 #endif /* AESD_CHAR_DRIVER_AESDCHAR_H_ */
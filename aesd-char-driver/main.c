@@ -20,17 +20,249 @@
 #include <linux/cdev.h>
 #include <linux/slab.h>
 #include <linux/fs.h> // file_operations
+#include <linux/mm.h> // kvcalloc
+#include <linux/rwsem.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
 #include <linux/uaccess.h>
 #include "aesdchar.h"
 #include "aesd_ioctl.h" //A-9 update
 
 int aesd_major = 0; // use dynamic major
 int aesd_minor = 0;
+// number of writes kept as history, the slot array is rounded up to a power of two
+unsigned int aesd_max_entries = AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED;
+module_param(aesd_max_entries, uint, S_IRUGO);
+MODULE_PARM_DESC(aesd_max_entries, "Number of writes kept in the circular buffer");
+// bytes of history visible through mmap, rounded up to a power of two
+unsigned int aesd_mmap_size = 1024 * 1024;
+module_param(aesd_mmap_size, uint, S_IRUGO);
+MODULE_PARM_DESC(aesd_mmap_size, "Bytes of the data ring exposed by mmap");
+// devices registered from aesd_minor, each with its own history
+unsigned int aesd_nr_devs = 1;
+module_param(aesd_nr_devs, uint, S_IRUGO);
+MODULE_PARM_DESC(aesd_nr_devs, "Number of aesdchar devices");
 
 MODULE_AUTHOR("Ayswariya Kannan");
 MODULE_LICENSE("Dual BSD/GPL");
 
-struct aesd_dev aesd_device;
+struct aesd_dev *aesd_devices; // aesd_nr_devs devices
+static struct kmem_cache *aesd_chunk_cache; // AESD_CHUNK_SIZE objects holding small entries
+
+/*
+ * @function	:  allocate a chunk able to hold size bytes, from aesd_chunk_cache when it fits
+ *
+ * @param		:  size : bytes to store
+ * @return		:  empty chunk, NULL when out of memory
+ *
+ */
+static struct aesd_chunk *aesd_chunk_alloc(size_t size)
+{
+    struct aesd_chunk *chunk;
+
+    if (size <= AESD_CHUNK_DATA_SIZE)
+    {
+        chunk = kmem_cache_alloc(aesd_chunk_cache, GFP_KERNEL);
+        size = AESD_CHUNK_DATA_SIZE;
+    }
+    else
+    {
+        chunk = kvmalloc(sizeof(struct aesd_chunk) + size, GFP_KERNEL);
+    }
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = NULL;
+    chunk->capacity = size;
+    chunk->len = 0;
+    return chunk;
+}
+
+/*
+ * @function	:  free a chunk back to where aesd_chunk_alloc took it from
+ *
+ * @param		:  chunk : chunk to free, may be NULL
+ * @return		:  NULL
+ *
+ */
+static void aesd_chunk_free(struct aesd_chunk *chunk)
+{
+    if (chunk == NULL)
+        return;
+    if (chunk->capacity <= AESD_CHUNK_DATA_SIZE)
+        kmem_cache_free(aesd_chunk_cache, chunk);
+    else
+        kvfree(chunk);
+}
+
+/*
+ * @function	:  free an entry storage given the buffptr of its entry
+ *
+ * @param		:  buffptr : data of a chunk, may be NULL
+ * @return		:  NULL
+ *
+ */
+static void aesd_entry_free(const char *buffptr)
+{
+    if (buffptr != NULL)
+        aesd_chunk_free(container_of(buffptr, struct aesd_chunk, data[0]));
+}
+
+/*
+ * @function	:  cut the partial write of an open file back to an earlier state, freeing the chunks added since
+ *
+ * @param		:  ctx : state of the open file, with its mutex held, tail : last chunk of that state, NULL when
+ *                 the partial write was empty, tail_len : length of tail then, size : partial_size then
+ * @return		:  NULL
+ *
+ */
+static void aesd_partial_truncate(struct aesd_file_ctx *ctx, struct aesd_chunk *tail, size_t tail_len, size_t size)
+{
+    struct aesd_chunk *chunk = (tail != NULL) ? tail->next : ctx->partial_head;
+
+    while (chunk != NULL)
+    {
+        struct aesd_chunk *next = chunk->next;
+        aesd_chunk_free(chunk);
+        chunk = next;
+    }
+    if (tail != NULL)
+    {
+        tail->len = tail_len;
+        tail->next = NULL;
+    }
+    else
+    {
+        ctx->partial_head = NULL;
+    }
+    ctx->partial_tail = tail;
+    ctx->partial_size = size;
+}
+
+/*
+ * @function	:  free the chunks of the partial write of an open file
+ *
+ * @param		:  ctx : state of the open file, with its mutex held
+ * @return		:  NULL
+ *
+ */
+static void aesd_partial_free(struct aesd_file_ctx *ctx)
+{
+    aesd_partial_truncate(ctx, NULL, 0, 0);
+}
+
+/*
+ * @function	:  hand the partial write of a file being released to its device, so that the next write
+ *                 of any file continues it like a write through the same file would
+ *
+ * @param		:  ctx : state of the file being released
+ * @return		:  NULL
+ *
+ */
+static void aesd_partial_leave(struct aesd_file_ctx *ctx)
+{
+    struct aesd_dev *dev = ctx->dev;
+
+    if (ctx->partial_head == NULL)
+        return;
+    mutex_lock(&dev->lock);
+    if (dev->leftover_tail != NULL)
+        dev->leftover_tail->next = ctx->partial_head;
+    else
+        dev->leftover_head = ctx->partial_head;
+    dev->leftover_tail = ctx->partial_tail;
+    dev->leftover_size += ctx->partial_size;
+    mutex_unlock(&dev->lock);
+    ctx->partial_head = ctx->partial_tail = NULL;
+    ctx->partial_size = 0;
+}
+
+/*
+ * @function	:  take over the writes left unterminated by released files of the device, only when this
+ *                 file has no partial write of its own
+ *
+ * @param		:  ctx : state of the open file, with its mutex held
+ * @return		:  NULL
+ *
+ */
+static void aesd_partial_adopt(struct aesd_file_ctx *ctx)
+{
+    struct aesd_dev *dev = ctx->dev;
+
+    // unlocked peek, another file may adopt the leftover before this one takes the lock
+    if (ctx->partial_head != NULL || READ_ONCE(dev->leftover_head) == NULL)
+        return;
+    mutex_lock(&dev->lock);
+    if (dev->leftover_head == NULL)
+    {
+        mutex_unlock(&dev->lock);
+        return;
+    }
+    ctx->partial_head = dev->leftover_head;
+    ctx->partial_tail = dev->leftover_tail;
+    ctx->partial_size = dev->leftover_size;
+    dev->leftover_head = dev->leftover_tail = NULL;
+    dev->leftover_size = 0;
+    mutex_unlock(&dev->lock);
+}
+/*
+ * @function	:  copy the entries just added to the circular buffer into the mapping, with the
+ *                 sequence counter odd while the header and ring change
+ *
+ * @param		:  dev : device, with the writer mutex held, added : number of entries just added
+ * @return		:  NULL
+ *
+ */
+static void aesd_mmap_update(struct aesd_dev *dev, uint32_t added)
+{
+    struct aesd_mmap_header *header = dev->mmap_header;
+    struct aesd_circular_buffer *buffer = &dev->circle_buff;
+    char *data = (char *)header + header->header_size;
+    uint64_t data_mask = header->data_size - 1;
+    // entries are numbered from the first write, this is the number of the oldest one held
+    uint64_t entry_number = header->first_entry + header->entry_count + added - buffer->count;
+    struct aesd_buffer_entry *entry;
+    uint32_t index;
+    uint64_t pos;
+    const char *src;
+    size_t size;
+    size_t first_part;
+
+    WRITE_ONCE(header->sequence, header->sequence + 1);
+    smp_wmb();
+
+    // entries added and evicted again by the same batch are never visible
+    for (index = (added < buffer->count) ? buffer->count - added : 0; index < buffer->count; index++)
+    {
+        entry = &buffer->entry[(buffer->out_offs + index) & buffer->entry_mask];
+        pos = entry->start_offs;
+        src = entry->buffptr;
+        size = entry->size;
+        // only the tail of an entry longer than the ring stays visible
+        if (size > header->data_size)
+        {
+            src += size - header->data_size;
+            pos += size - header->data_size;
+            size = header->data_size;
+        }
+        first_part = min_t(size_t, size, header->data_size - (pos & data_mask));
+        memcpy(data + (pos & data_mask), src, first_part);
+        memcpy(data, src + first_part, size - first_part);
+
+        header->entries[(entry_number + index) & header->entry_mask].start = entry->start_offs;
+        header->entries[(entry_number + index) & header->entry_mask].size = entry->size;
+    }
+    header->entry_count = buffer->count;
+    header->first_entry = entry_number;
+    header->start = buffer->entry[buffer->out_offs].start_offs;
+    header->end = buffer->end_offs;
+
+    smp_wmb();
+    WRITE_ONCE(header->sequence, header->sequence + 1);
+}
+
 /*
  * @function	:  Open call to open the character device
  *
@@ -40,10 +272,14 @@ struct aesd_dev aesd_device;
  */
 int aesd_open(struct inode *inode, struct file *filp)
 {
-    struct aesd_dev *dev;
+    struct aesd_file_ctx *ctx;
     PDEBUG("open");
-    dev = container_of(inode->i_cdev, struct aesd_dev, cdev);
-    filp->private_data = dev;
+    ctx = kzalloc(sizeof(struct aesd_file_ctx), GFP_KERNEL);
+    if (ctx == NULL)
+        return -ENOMEM;
+    ctx->dev = container_of(inode->i_cdev, struct aesd_dev, cdev);
+    mutex_init(&ctx->lock);
+    filp->private_data = ctx;
     return 0;
 }
 /*
@@ -56,16 +292,38 @@ int aesd_open(struct inode *inode, struct file *filp)
 int aesd_release(struct inode *inode, struct file *filp)
 {
     PDEBUG("release");
-
+    // a command left without its newline is continued by the next write to the device
+    aesd_partial_leave(filp->private_data);
+    kfree(filp->private_data);
     return 0;
 }
 
 /*
- * @function	:  read from file at position pos of size_t count
+ * @function	:  move f_pos of a file in wait mode to the byte following the last one it read, which moves
+ *                 down as older entries are evicted, called with buffer_lock held
+ *
+ * @param		:  ctx : state of the open file, f_pos : position to update
+ * @return		:  NULL
+ *
+ */
+static void aesd_file_sync_pos(struct aesd_file_ctx *ctx, loff_t *f_pos)
+{
+    // stream position of the oldest byte held
+    size_t first = ctx->dev->circle_buff.end_offs - ctx->dev->circle_buff.total_size;
+
+    if (ctx->stream_valid)
+        *f_pos = (ctx->stream_pos > first) ? ctx->stream_pos - first : 0;
+}
+
+/*
+ * @function	:  read from file at position pos of size_t count, filling buf from as many
+ *                 consecutive entries as fit with one copy_to_user per entry
  *
  * @param		:  buf-pointer to store the data read from file,
  *                 count the number of bytes required to be read
  *                 f_pos offset location in kernel buffer from where data need to be read.
+ *                 At the end of the history a file in wait mode sleeps until the next entry is added,
+ *                 or fails with -EAGAIN when opened O_NONBLOCK, other files read 0.
  * @return		:  retval :no of bytes successfully read
  *
  */
@@ -73,73 +331,309 @@ ssize_t aesd_read(struct file *filp, char __user *buf, size_t count,
                   loff_t *f_pos)
 {
     ssize_t retval = 0;
+    struct aesd_file_ctx *ctx;
     struct aesd_dev *dev;
     // entry and offset for circular buffer
     struct aesd_buffer_entry *read_index = NULL; // variable to saveaddress of the read index returned from reading function
-    ssize_t read_offset = 0;                     // offset for reading is zero in the case
-    ssize_t unread_count = 0;                    // unread bytes
+    size_t read_offset = 0;                      // offset inside the first entry, zero for the following ones
+    size_t entry_start = 0;                      // position of the following entry, unused
+    uint32_t entry_index = 0;                    // index of read_index counted from the oldest entry
+    size_t copy_count = 0;                       // bytes copied from the current entry
+    size_t unread_count = 0;                     // unread bytes
 
     PDEBUG("read %zu bytes with offset %lld", count, *f_pos);
 
-    // get the skull device from the passed file structure
-    dev = (struct aesd_dev *)filp->private_data;
-
     // to check for error
     if (filp == NULL || buf == NULL || f_pos == NULL)
     {
         return -EFAULT;
     }
 
-    // lock the mutex with interruptable option and check for error
-    if (mutex_lock_interruptible(&dev->lock))
+    // get the skull device from the passed file structure
+    ctx = (struct aesd_file_ctx *)filp->private_data;
+    dev = ctx->dev;
+
+    // readers only exclude a writer adding an entry, not each other
+    if (down_read_interruptible(&dev->buffer_lock))
     {
-        PDEBUG(KERN_ERR "mutex lock unsuccessful");
+        PDEBUG(KERN_ERR "buffer lock unsuccessful");
         return -ERESTARTSYS; // error condition
     }
 
+    if (ctx->wait)
+    {
+        aesd_file_sync_pos(ctx, f_pos);
+        while (*f_pos >= dev->circle_buff.total_size)
+        {
+            ctx->stream_pos = dev->circle_buff.end_offs - dev->circle_buff.total_size + *f_pos;
+            ctx->stream_valid = true;
+            if (filp->f_flags & O_NONBLOCK)
+            {
+                retval = -EAGAIN;
+                goto error_path;
+            }
+            up_read(&dev->buffer_lock);
+            // end_offs only grows, a writer wakes the queue after adding an entry
+            if (wait_event_interruptible(dev->read_queue, READ_ONCE(dev->circle_buff.end_offs) > ctx->stream_pos))
+                return -ERESTARTSYS;
+            if (down_read_interruptible(&dev->buffer_lock))
+                return -ERESTARTSYS;
+            aesd_file_sync_pos(ctx, f_pos);
+        }
+    }
+
     // find the read index to read from the file
     read_index = aesd_circular_buffer_find_entry_offset_for_fpos(&(dev->circle_buff), *f_pos, &read_offset);
     if (read_index == NULL)
     {
-        goto error_path; // to unlock mutex
+        goto error_path; // to release the buffer lock
     }
-    else
+    entry_index = ((read_index - dev->circle_buff.entry) - dev->circle_buff.out_offs) & dev->circle_buff.entry_mask;
+
+    // continue into the following entries until buf is full or the buffer ends
+    while (read_index != NULL && (size_t)retval < count)
     {
+        copy_count = read_index->size - read_offset;
+        if (copy_count > count - (size_t)retval)
+            copy_count = count - (size_t)retval;
 
-        /*check if the count is greater that read size of the buffer,if it the
-        make count = read_size - read_offset*/
-        if (count > (read_index->size - read_offset))
-            count = read_index->size - read_offset;
+        //  read using copy_to_user
+        unread_count = copy_to_user(buf + retval, (read_index->buffptr + read_offset), copy_count);
+        retval += copy_count - unread_count;
+        if (unread_count)
+        {
+            // a fault before anything was copied is an error, otherwise a short read
+            if (retval == 0)
+                retval = -EFAULT;
+            break;
+        }
+        read_offset = 0;
+        read_index = aesd_circular_buffer_entry_at(&dev->circle_buff, ++entry_index, &entry_start);
     }
-    //  read using copy_to_user
-    unread_count = copy_to_user(buf, (read_index->buffptr + read_offset), count);
 
-    // return the read size and update the f_pos
-    retval = count - unread_count;
-    *f_pos += retval;
+    // update the f_pos by the read size
+    if (retval > 0)
+        *f_pos += retval;
+    if (ctx->wait)
+    {
+        ctx->stream_pos = dev->circle_buff.end_offs - dev->circle_buff.total_size + *f_pos;
+        ctx->stream_valid = true;
+    }
 
 error_path:
-    mutex_unlock(&(dev->lock));
+    up_read(&dev->buffer_lock);
 
     return retval;
 }
 
 /*
- * @function	:  read from file at position pos of size_t count
+ * Commands completed by one write call, linked through aesd_chunk.next until aesd_commit inserts them
+ */
+struct aesd_pending
+{
+    struct aesd_chunk *head;
+    struct aesd_chunk **tail;
+    uint32_t count;
+};
+
+static void aesd_pending_init(struct aesd_pending *pending)
+{
+    pending->head = NULL;
+    pending->tail = &pending->head;
+    pending->count = 0;
+}
+
+/*
+ * @function	:  append buf to the partial write of a file, which becomes a pending command when buf
+ *                 contains a \n. Bytes taken from an iterator stop at its first \n instead, the ones after
+ *                 it are left in the iterator for the next command
  *
- * @param		:  buf-pointer to store the data read from file,
- *                 count the number of bytes required to be read
- *                 f_pos offset location in kernel buffer from where data need to be read.
- * @return		:  retval :no of bytes successfully read
+ * @param		:  ctx : state of the open file, with its mutex held, buf : user data of count bytes,
+ *                 from : iterator of count bytes copied instead of buf when not NULL, advanced by the
+ *                 bytes consumed, pending : list the completed command is added to
+ * @return		:  retval :no of bytes consumed, negative error code when none. When the command cannot
+ *                 be gathered none of the bytes is consumed, so a retry of the write completes it
+ *
+ */
+static ssize_t aesd_append(struct aesd_file_ctx *ctx, const char __user *buf, struct iov_iter *from,
+                           size_t count, struct aesd_pending *pending)
+{
+    struct aesd_chunk *chunk = NULL;
+    struct aesd_chunk *piece = NULL;
+    struct aesd_chunk *old_tail = NULL;
+    size_t old_tail_len = 0;
+    size_t old_size = 0;
+    ssize_t retval = 0;
+    size_t copy_count = 0;
+    size_t unwritten_count = 0;
+    const char *newline_at = NULL;
+    bool newline = false;
+
+    aesd_partial_adopt(ctx);
+    // state of the partial write before this call, restored when the command cannot be gathered
+    old_tail = ctx->partial_tail;
+    old_tail_len = (old_tail != NULL) ? old_tail->len : 0;
+    old_size = ctx->partial_size;
+
+    // append to the last chunk of the partial write, adding chunks instead of reallocating
+    while ((size_t)retval < count)
+    {
+        chunk = ctx->partial_tail;
+        if (chunk == NULL || chunk->len == chunk->capacity)
+        {
+            // the \n of an iterator only shows once its bytes are copied, so they go to
+            // cache sized chunks gathered once the command is complete
+            chunk = aesd_chunk_alloc((from != NULL) ? AESD_CHUNK_DATA_SIZE : count - retval);
+            if (chunk == NULL)
+            {
+                PDEBUG("chunk allocation error");
+                if (retval == 0)
+                    retval = -ENOMEM;
+                break;
+            }
+            if (ctx->partial_tail != NULL)
+                ctx->partial_tail->next = chunk;
+            else
+                ctx->partial_head = chunk;
+            ctx->partial_tail = chunk;
+        }
+        copy_count = min_t(size_t, count - retval, chunk->capacity - chunk->len);
+
+        // copy data from user space buffer, or from the iterator, which advances by the bytes copied
+        if (from != NULL)
+            unwritten_count = copy_count - copy_from_iter(chunk->data + chunk->len, copy_count, from);
+        else
+            unwritten_count = copy_from_user(chunk->data + chunk->len, buf + retval, copy_count);
+        copy_count -= unwritten_count; // actual bytes written
+        // the bytes written before had no \n, only search the new ones
+        newline_at = memchr(chunk->data + chunk->len, '\n', copy_count);
+        if (newline_at != NULL)
+        {
+            newline = true;
+            if (from != NULL)
+            {
+                // the command of an iterator ends at its \n, give the bytes after it back
+                iov_iter_revert(from, chunk->data + chunk->len + copy_count - (newline_at + 1));
+                copy_count = newline_at + 1 - (chunk->data + chunk->len);
+                unwritten_count = 0;
+            }
+        }
+        chunk->len += copy_count;
+        ctx->partial_size += copy_count;
+        retval += copy_count;
+        if (unwritten_count)
+        {
+            if (retval == 0)
+                retval = -EFAULT;
+            break;
+        }
+        if (newline && from != NULL)
+            break;
+    }
+
+    // if \n character found means end of packet,thus if found the partial write becomes a command
+    if (newline)
+    {
+        chunk = ctx->partial_head;
+        if (chunk->next != NULL)
+        {
+            // the write arrived in pieces, gather them into one storage once
+            chunk = aesd_chunk_alloc(ctx->partial_size);
+            if (chunk == NULL)
+            {
+                PDEBUG("chunk allocation error");
+                // the \n would be lost in the partial write, give the bytes of this call back instead
+                aesd_partial_truncate(ctx, old_tail, old_tail_len, old_size);
+                if (from != NULL)
+                    iov_iter_revert(from, retval);
+                return -ENOMEM;
+            }
+            for (piece = ctx->partial_head; piece != NULL; piece = piece->next)
+            {
+                memcpy(chunk->data + chunk->len, piece->data, piece->len);
+                chunk->len += piece->len;
+            }
+            aesd_partial_free(ctx);
+        }
+        // clear entry parameters
+        ctx->partial_head = ctx->partial_tail = NULL;
+        ctx->partial_size = 0;
+
+        *pending->tail = chunk;
+        pending->tail = &chunk->next;
+        pending->count++;
+    }
+    return retval;
+}
+
+/*
+ * @function	:  insert the pending commands into the circular buffer of dev and the mapping, taking
+ *                 the locks once for all of them
+ *
+ * @param		:  dev : device to add to, pending : commands from aesd_append
+ * @return		:  NULL
+ *
+ */
+static void aesd_commit(struct aesd_dev *dev, struct aesd_pending *pending)
+{
+    struct aesd_chunk *chunk = NULL;
+    struct aesd_chunk *next = NULL;
+    struct aesd_chunk *evicted = NULL;
+    struct aesd_buffer_entry add_entry;
+    const char *write_entry = NULL;
+
+    if (pending->count == 0)
+        return;
+
+    // the data is consumed already, wait for the other writers of the device without interruption,
+    // readers are held off just for the insertions
+    mutex_lock(&dev->lock);
+    down_write(&dev->buffer_lock);
+    for (chunk = pending->head; chunk != NULL; chunk = next)
+    {
+        next = chunk->next;
+        chunk->next = NULL;
+        add_entry.buffptr = chunk->data;
+        add_entry.size = chunk->len;
+        write_entry = aesd_circular_buffer_add_entry(&dev->circle_buff, &add_entry);
+        if (write_entry != NULL)
+        {
+            // an entry evicted by this batch was already walked past, its next is free to link it
+            struct aesd_chunk *old = container_of(write_entry, struct aesd_chunk, data[0]);
+            old->next = evicted;
+            evicted = old;
+        }
+    }
+    up_write(&dev->buffer_lock);
+    aesd_mmap_update(dev, pending->count);
+    mutex_unlock(&dev->lock);
+    wake_up_interruptible(&dev->read_queue);
+
+    // free the evicted entries
+    while (evicted != NULL)
+    {
+        next = evicted->next;
+        aesd_chunk_free(evicted);
+        evicted = next;
+    }
+    aesd_pending_init(pending);
+}
+
+/*
+ * @function	:  write system call, the buffer is appended to the partial write of the file and
+ *                 becomes an entry when it contains a \n
+ *
+ * @param		:  buf-pointer to the data to write, count the number of bytes in buf,
+ *                 f_pos unused, entries are always appended
+ * @return		:  retval :no of bytes successfully written
  *
  */
 ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count,
                    loff_t *f_pos)
 {
-    struct aesd_dev *dev;
-    const char *write_entry = NULL;
-    ssize_t retval = -ENOMEM;
-    ssize_t unwritten_count = 0;
+    struct aesd_file_ctx *ctx;
+    struct aesd_pending pending;
+    ssize_t retval = 0;
     PDEBUG("write %zu bytes with offset %lld", count, *f_pos);
 
     // check for errors
@@ -149,65 +643,111 @@ ssize_t aesd_write(struct file *filp, const char __user *buf, size_t count,
         return -EFAULT;
 
     // save the aesd_device data from private data
-    dev = (struct aesd_dev *)filp->private_data;
+    ctx = (struct aesd_file_ctx *)filp->private_data;
 
-    // lock the mutex
-    if (mutex_lock_interruptible(&(dev->lock)))
+    // lock the mutex of this file, the partial write is not shared with other files
+    if (mutex_lock_interruptible(&(ctx->lock)))
     {
         PDEBUG(KERN_ERR "could not acquire mutex lock");
         return -ERESTARTSYS;
     }
 
-    // if  buffer size is zero, then allocate the buffer using kmalloc, store address in buffptr
-    if (dev->circle_buff_entry.size == 0)
-    {
-        PDEBUG("Allocating buffer");
+    PDEBUG("writing to buffer");
+    aesd_pending_init(&pending);
+    retval = aesd_append(ctx, buf, NULL, count, &pending);
+    aesd_commit(ctx->dev, &pending);
 
-        dev->circle_buff_entry.buffptr = kmalloc(count * sizeof(char), GFP_KERNEL);
+    mutex_unlock(&ctx->lock);
 
-        if (dev->circle_buff_entry.buffptr == NULL)
-        {
-            PDEBUG("kmalloc error");
-            goto error_path_write;
-        }
-    }
-    // realloc if already allocated
-    else
-    {
+    return retval;
+}
 
-        dev->circle_buff_entry.buffptr = krealloc(dev->circle_buff_entry.buffptr, (dev->circle_buff_entry.size + count) * sizeof(char), GFP_KERNEL);
+/*
+ * @function	:  writev and io_uring writes, the bytes of all segments become one command per \n and
+ *                 the completed commands are inserted together. Unlike aesd_write, which keeps a buffer
+ *                 as one command, see AESDCHAR_IOCWRITEV
+ *
+ * @param		:  iocb : kernel I/O control block of the file, from : bytes to write
+ * @return		:  retval :no of bytes successfully written
+ *
+ */
+ssize_t aesd_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    struct aesd_file_ctx *ctx = (struct aesd_file_ctx *)iocb->ki_filp->private_data;
+    struct aesd_pending pending;
+    size_t count;
+    ssize_t written;
+    ssize_t retval = 0;
+
+    PDEBUG("write_iter %zu bytes", iov_iter_count(from));
+    if (mutex_lock_interruptible(&(ctx->lock)))
+        return -ERESTARTSYS;
 
-        if (dev->circle_buff_entry.buffptr == NULL)
+    aesd_pending_init(&pending);
+    while ((count = iov_iter_count(from)) > 0)
+    {
+        // every call takes one command, or the bytes up to a fault, which the next call then reports
+        written = aesd_append(ctx, NULL, from, count, &pending);
+        if (written < 0)
         {
-            PDEBUG("krealloc error");
-            goto error_path_write;
+            if (retval == 0)
+                retval = written;
+            break;
         }
+        retval += written;
     }
-    PDEBUG("writing to buffer");
-    // copy data from user space buffer
-    unwritten_count = copy_from_user((void *)(dev->circle_buff_entry.buffptr + dev->circle_buff_entry.size),
-                                     buf, count);
-    retval = count - unwritten_count; // actual bytes written
-    dev->circle_buff_entry.size += retval;
+    aesd_commit(ctx->dev, &pending);
 
-    // if \n character found means end of packet,thus if found add the entry in circular buffer
-    if (memchr(dev->circle_buff_entry.buffptr, '\n', dev->circle_buff_entry.size))
-    {
+    mutex_unlock(&ctx->lock);
+    return retval;
+}
 
-        write_entry = aesd_circular_buffer_add_entry(&dev->circle_buff, &dev->circle_buff_entry);
-        if (write_entry)
+/*
+ * @function	:  AESDCHAR_IOCWRITEV, every command is handled like the buffer of one write() and the
+ *                 completed commands are inserted together
+ *
+ * @param		:  filp:kernel file structure passed, batch : batch copied from userspace
+ * @return		:  retval :no of bytes successfully written, negative error code when none
+ *
+ */
+static long aesd_write_batch(struct file *filp, const struct aesd_write_batch *batch)
+{
+    struct aesd_file_ctx *ctx = (struct aesd_file_ctx *)filp->private_data;
+    const struct aesd_write_vec __user *uvec = u64_to_user_ptr(batch->vec);
+    struct aesd_write_vec vec;
+    struct aesd_pending pending;
+    ssize_t written;
+    long retval = 0;
+    uint32_t index;
+
+    if (batch->count > AESDCHAR_WRITEV_MAX)
+        return -EINVAL;
+    if (mutex_lock_interruptible(&(ctx->lock)))
+        return -ERESTARTSYS;
+
+    aesd_pending_init(&pending);
+    for (index = 0; index < batch->count; index++)
+    {
+        if (copy_from_user(&vec, uvec + index, sizeof(vec)))
         {
-            kfree(write_entry); // free the temporary pointer
+            if (retval == 0)
+                retval = -EFAULT;
+            break;
         }
-        // clear entry parameters
-        dev->circle_buff_entry.buffptr = NULL;
-        dev->circle_buff_entry.size = 0;
+        written = aesd_append(ctx, u64_to_user_ptr(vec.buf), NULL, vec.len, &pending);
+        if (written < 0)
+        {
+            if (retval == 0)
+                retval = written;
+            break;
+        }
+        retval += written;
+        if ((size_t)written < vec.len)
+            break;
     }
+    aesd_commit(ctx->dev, &pending);
 
-    // handle errors
-error_path_write:
-    mutex_unlock(&dev->lock);
-
+    mutex_unlock(&ctx->lock);
     return retval;
 }
 /*
@@ -220,8 +760,9 @@ error_path_write:
 static long aesd_adjust_file_offset(struct file *filp, unsigned int write_cmd, unsigned int write_cmd_offset)
 {
     struct aesd_buffer_entry *buff_entry = NULL;
+    struct aesd_file_ctx *ctx = NULL;
     struct aesd_dev *dev = NULL;
-    uint8_t index = 0;
+    size_t entry_start = 0;
     long retval = 0;
     PDEBUG("AESDCHAR_IOCSEEKTO command implementation\n");
     if (filp == NULL)
@@ -229,33 +770,25 @@ static long aesd_adjust_file_offset(struct file *filp, unsigned int write_cmd, u
 
         return -EFAULT;
     }
-    dev = filp->private_data;
-    if (mutex_lock_interruptible(&(dev->lock)))
+    ctx = filp->private_data;
+    dev = ctx->dev;
+    if (down_read_interruptible(&dev->buffer_lock))
     {
-        PDEBUG(KERN_ERR "could not acquire mutex lock");
+        PDEBUG(KERN_ERR "could not acquire buffer lock");
         return -ERESTARTSYS;
     }
-    AESD_CIRCULAR_BUFFER_FOREACH(buff_entry, &dev->circle_buff, index); // to get the last index value inside the buffer
-    if (write_cmd > index || write_cmd_offset >= (dev->circle_buff.entry[write_cmd].size) || write_cmd > AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED)
+    // write_cmd counts from the oldest entry held, its start offset is cached so no entry is summed
+    buff_entry = aesd_circular_buffer_entry_at(&dev->circle_buff, write_cmd, &entry_start);
+    if (buff_entry == NULL || write_cmd_offset >= buff_entry->size)
     {
         retval = -EINVAL;
     }
     else
     {
-        if (write_cmd == 0)
-        {
-            filp->f_pos += write_cmd_offset;
-        }
-        else
-        {
-            for (index = 0; index < write_cmd; index++)
-            {
-                filp->f_pos += dev->circle_buff.entry[index].size;
-            }
-            filp->f_pos += write_cmd_offset;
-        }
+        filp->f_pos = entry_start + write_cmd_offset;
+        ctx->stream_valid = false;
     }
-    mutex_unlock(&dev->lock);
+    up_read(&dev->buffer_lock);
     return retval;
 }
 /*
@@ -271,6 +804,8 @@ long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     int err = 0;
     long retval = 0;
     struct aesd_seekto seekto;
+    struct aesd_write_batch batch;
+    uint32_t wait;
     if (filp == NULL)
     {
 
@@ -311,6 +846,25 @@ long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         }
         break;
 
+    case AESDCHAR_IOCWAIT:
+        if (get_user(wait, (uint32_t __user *)arg))
+            retval = -EFAULT;
+        else
+        {
+            PDEBUG("Implementing AESDCHAR_IOCWAIT %u\n", wait);
+            // the first read in wait mode starts from f_pos
+            ((struct aesd_file_ctx *)filp->private_data)->wait = (wait != 0);
+            ((struct aesd_file_ctx *)filp->private_data)->stream_valid = false;
+        }
+        break;
+
+    case AESDCHAR_IOCWRITEV:
+        if (copy_from_user(&batch, (const void __user *)arg, sizeof(batch)))
+            retval = -EFAULT;
+        else
+            retval = aesd_write_batch(filp, &batch);
+        break;
+
     default: 
         return -ENOTTY;
     }
@@ -326,11 +880,10 @@ long aesd_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 loff_t aesd_llseek(struct file *filp, loff_t offset, int whence)
 {
 
+    struct aesd_file_ctx *ctx = NULL;
     struct aesd_dev *dev = NULL;
-    struct aesd_buffer_entry *seek_entry = NULL;
     loff_t buffer_size = 0;
     loff_t seek_pos = 0;
-    uint8_t index = 0;
 
     PDEBUG("llseek implementation\n");
 
@@ -341,40 +894,119 @@ loff_t aesd_llseek(struct file *filp, loff_t offset, int whence)
         return -EFAULT;
     }
 
-    dev = (struct aesd_dev *)filp->private_data;
-
-    // lock the mutex
-    if (mutex_lock_interruptible(&(dev->lock)))
-    {
-        PDEBUG(KERN_ERR "could not acquire mutex lock");
-        return -ERESTARTSYS;
-    }
+    ctx = (struct aesd_file_ctx *)filp->private_data;
+    dev = ctx->dev;
 
-    // getting size of buffer
-    AESD_CIRCULAR_BUFFER_FOREACH(seek_entry, &dev->circle_buff, index)
-    {
-        buffer_size += seek_entry->size;
-    }
+    // the size is maintained by every write, a single word read needs no lock, a concurrent
+    // write only decides whether SEEK_END lands before or after it
+    buffer_size = READ_ONCE(dev->circle_buff.total_size);
         //have used the fixed_size_llseek() function 
     seek_pos = fixed_size_llseek(filp, offset, whence, buffer_size);
-
-    mutex_unlock(&dev->lock);
+    if (seek_pos >= 0)
+        ctx->stream_valid = false; // wait mode reads continue from the new f_pos
 
     return seek_pos;
 }
+/*
+ * @function	:  page fault of a mapping, the header pages map once and the data ring twice in a row
+ *
+ * @param		:  vmf : faulting address of a mapping set up by aesd_mmap
+ * @return		:  0 with vmf->page set, VM_FAULT_SIGBUS past the end
+ *
+ */
+static vm_fault_t aesd_mmap_fault(struct vm_fault *vmf)
+{
+    struct aesd_dev *dev = vmf->vma->vm_private_data;
+    unsigned long header_pages = dev->mmap_header->header_size >> PAGE_SHIFT;
+    unsigned long data_pages = dev->mmap_header->data_size >> PAGE_SHIFT;
+    pgoff_t pgoff = vmf->pgoff;
+    struct page *page;
+
+    if (pgoff >= header_pages + 2 * data_pages)
+        return VM_FAULT_SIGBUS;
+    if (pgoff >= header_pages)
+        pgoff = header_pages + (pgoff - header_pages) % data_pages;
+    page = vmalloc_to_page((char *)dev->mmap_header + (pgoff << PAGE_SHIFT));
+    get_page(page);
+    vmf->page = page;
+    return 0;
+}
+
+static const struct vm_operations_struct aesd_vm_ops = {
+    .fault = aesd_mmap_fault,
+};
+
+/*
+ * @function	:  mmap system call, maps the history read-only as described in aesd_ioctl.h
+ *
+ * @param		:  filp:kernel file structure passed, vma : mapping to set up
+ * @return		:  0 on success, -EACCES for writable mappings, -EINVAL past the end
+ *
+ */
+int aesd_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct aesd_dev *dev = ((struct aesd_file_ctx *)filp->private_data)->dev;
+    unsigned long pages = (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
+    unsigned long max_pages = (dev->mmap_header->header_size + 2 * dev->mmap_header->data_size) >> PAGE_SHIFT;
+
+    PDEBUG("mmap %lu pages at page %lu", pages, vma->vm_pgoff);
+    if (vma->vm_flags & VM_WRITE)
+        return -EACCES;
+    if (vma->vm_pgoff > max_pages || pages > max_pages - vma->vm_pgoff)
+        return -EINVAL;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+    vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+#endif
+    vma->vm_ops = &aesd_vm_ops;
+    vma->vm_private_data = dev;
+    return 0;
+}
+
+/*
+ * @function	:  poll system call, readable while there are bytes past the file position, always writable
+ *
+ * @param		:  filp:kernel file structure passed, wait : poll table to add the read queue to
+ * @return		:  mask of the ready events
+ *
+ */
+__poll_t aesd_poll(struct file *filp, poll_table *wait)
+{
+    struct aesd_file_ctx *ctx = (struct aesd_file_ctx *)filp->private_data;
+    struct aesd_dev *dev = ctx->dev;
+    __poll_t mask = EPOLLOUT | EPOLLWRNORM; // writes never wait for space
+    loff_t pos = filp->f_pos;
+
+    poll_wait(filp, &dev->read_queue, wait);
+    down_read(&dev->buffer_lock);
+    if (ctx->wait)
+        aesd_file_sync_pos(ctx, &pos);
+    if (pos < dev->circle_buff.total_size)
+        mask |= EPOLLIN | EPOLLRDNORM;
+    up_read(&dev->buffer_lock);
+    return mask;
+}
+
 struct file_operations aesd_fops =
     {
         .owner = THIS_MODULE,
         .read = aesd_read,
         .write = aesd_write,
+        .write_iter = aesd_write_iter,
         .open = aesd_open,
         .release = aesd_release,
         .llseek = aesd_llseek,
+        .mmap = aesd_mmap,
+        .poll = aesd_poll,
         .unlocked_ioctl = aesd_ioctl};
 
-static int aesd_setup_cdev(struct aesd_dev *dev)
+static int aesd_setup_cdev(struct aesd_dev *dev, unsigned int index)
 {
-    int err, devno = MKDEV(aesd_major, aesd_minor);
+    int err, devno = MKDEV(aesd_major, aesd_minor + index);
 
     cdev_init(&dev->cdev, &aesd_fops);
     dev->cdev.owner = THIS_MODULE;
@@ -382,10 +1014,92 @@ static int aesd_setup_cdev(struct aesd_dev *dev)
     err = cdev_add(&dev->cdev, devno, 1);
     if (err)
     {
-        printk(KERN_ERR "Error %d adding aesd cdev", err);
+        printk(KERN_ERR "Error %d adding aesd%u cdev", err, index);
     }
     return err;
 }
+/*
+ * @function	: allocate the circular buffer and mapping of one device and register it
+ *
+ * @param		: dev : zeroed device, index : number of the device counted from aesd_minor
+ * @return		: 0 on success, negative error code with nothing left allocated
+ *
+ */
+static int aesd_dev_init(struct aesd_dev *dev, unsigned int index)
+{
+    int result;
+    uint32_t slots;
+    struct aesd_buffer_entry *entries;
+    size_t mmap_header_size;
+    size_t mmap_data_size;
+    struct aesd_mmap_header *mmap_header;
+
+    slots = aesd_circular_buffer_slots(aesd_max_entries);
+    entries = kvcalloc(slots, sizeof(struct aesd_buffer_entry), GFP_KERNEL);
+    if (entries == NULL)
+    {
+        return -ENOMEM;
+    }
+    // header and entry table on their own pages, then the data ring
+    mmap_header_size = PAGE_ALIGN(sizeof(struct aesd_mmap_header) + slots * sizeof(struct aesd_mmap_entry));
+    mmap_data_size = roundup_pow_of_two(max_t(size_t, aesd_mmap_size, PAGE_SIZE));
+    mmap_header = vmalloc_user(mmap_header_size + mmap_data_size);
+    if (mmap_header == NULL)
+    {
+        kvfree(entries);
+        return -ENOMEM;
+    }
+    mmap_header->magic = AESDCHAR_MMAP_MAGIC;
+    mmap_header->header_size = mmap_header_size;
+    mmap_header->data_size = mmap_data_size;
+    mmap_header->entry_mask = slots - 1;
+
+    // Initialize the mutex and circular buffer
+    mutex_init(&dev->lock);
+    init_rwsem(&dev->buffer_lock);
+    init_waitqueue_head(&dev->read_queue);
+    aesd_circular_buffer_init_entries(&dev->circle_buff, entries, slots, aesd_max_entries);
+    dev->mmap_header = mmap_header;
+
+    result = aesd_setup_cdev(dev, index);
+    if (result)
+    {
+        vfree(mmap_header);
+        kvfree(entries);
+    }
+    return result;
+}
+/*
+ * @function	: unregister one device set up by aesd_dev_init and free its entries
+ *
+ * @param		: dev : device to free
+ * @return		: NULL
+ *
+ */
+static void aesd_dev_cleanup(struct aesd_dev *dev)
+{
+    // free circular buffer entries
+    struct aesd_buffer_entry *entry = NULL;
+    struct aesd_chunk *chunk = dev->leftover_head;
+    uint32_t index = 0;
+
+    cdev_del(&dev->cdev);
+
+    // and the write no file continued
+    while (chunk != NULL)
+    {
+        struct aesd_chunk *next = chunk->next;
+        aesd_chunk_free(chunk);
+        chunk = next;
+    }
+
+    AESD_CIRCULAR_BUFFER_FOREACH(entry, &dev->circle_buff, index)
+    {
+        aesd_entry_free(entry->buffptr);
+    }
+    kvfree(dev->circle_buff.entry);
+    vfree(dev->mmap_header);
+}
 /*
  * @function	: It is used to register the device and initialize the kernel structure
  *
@@ -397,25 +1111,59 @@ int aesd_init_module(void)
 {
     dev_t dev = 0;
     int result;
-    result = alloc_chrdev_region(&dev, aesd_minor, 1,
+    unsigned int index;
+
+    if (aesd_max_entries == 0 || aesd_max_entries > AESDCHAR_MAX_ENTRIES_LIMIT)
+    {
+        printk(KERN_WARNING "aesd_max_entries must be between 1 and %u\n", AESDCHAR_MAX_ENTRIES_LIMIT);
+        return -EINVAL;
+    }
+    if (aesd_mmap_size == 0 || aesd_mmap_size > (1U << 30))
+    {
+        printk(KERN_WARNING "aesd_mmap_size must be between 1 and %u\n", 1U << 30);
+        return -EINVAL;
+    }
+    if (aesd_nr_devs == 0 || aesd_nr_devs > AESD_MAX_DEVS)
+    {
+        printk(KERN_WARNING "aesd_nr_devs must be between 1 and %u\n", AESD_MAX_DEVS);
+        return -EINVAL;
+    }
+    aesd_devices = kcalloc(aesd_nr_devs, sizeof(struct aesd_dev), GFP_KERNEL);
+    if (aesd_devices == NULL)
+    {
+        return -ENOMEM;
+    }
+    aesd_chunk_cache = kmem_cache_create("aesd_chunk", AESD_CHUNK_SIZE, 0, SLAB_HWCACHE_ALIGN, NULL);
+    if (aesd_chunk_cache == NULL)
+    {
+        kfree(aesd_devices);
+        return -ENOMEM;
+    }
+    result = alloc_chrdev_region(&dev, aesd_minor, aesd_nr_devs,
                                  "aesdchar");
     aesd_major = MAJOR(dev);
     if (result < 0)
     {
         printk(KERN_WARNING "Can't get major %d\n", aesd_major);
+        kmem_cache_destroy(aesd_chunk_cache);
+        kfree(aesd_devices);
         return result;
     }
-    memset(&aesd_device, 0, sizeof(struct aesd_dev));
-
-    // Initialize the mutex and circular buffer
-    mutex_init(&aesd_device.lock);
-    aesd_circular_buffer_init(&aesd_device.circle_buff);
-
-    result = aesd_setup_cdev(&aesd_device);
 
+    for (index = 0; index < aesd_nr_devs; index++)
+    {
+        result = aesd_dev_init(&aesd_devices[index], index);
+        if (result)
+            break;
+    }
     if (result)
     {
-        unregister_chrdev_region(dev, 1);
+        // undo the devices set up before the failing one
+        while (index-- > 0)
+            aesd_dev_cleanup(&aesd_devices[index]);
+        unregister_chrdev_region(dev, aesd_nr_devs);
+        kmem_cache_destroy(aesd_chunk_cache);
+        kfree(aesd_devices);
     }
     return result;
 }
@@ -427,24 +1175,14 @@ int aesd_init_module(void)
  */
 void aesd_cleanup_module(void)
 {
-    // free circular buffer entries
-    struct aesd_buffer_entry *entry = NULL;
-    uint8_t index = 0;
     dev_t devno = MKDEV(aesd_major, aesd_minor);
+    unsigned int index;
 
-    cdev_del(&aesd_device.cdev);
-
-    // free the circle_buff_entry buffptr
-    kfree(aesd_device.circle_buff_entry.buffptr);
-
-    AESD_CIRCULAR_BUFFER_FOREACH(entry, &aesd_device.circle_buff, index)
-    {
-        if (entry->buffptr != NULL)
-        {
-            kfree(entry->buffptr);
-        }
-    }
-    unregister_chrdev_region(devno, 1);
+    for (index = 0; index < aesd_nr_devs; index++)
+        aesd_dev_cleanup(&aesd_devices[index]);
+    kfree(aesd_devices);
+    kmem_cache_destroy(aesd_chunk_cache);
+    unregister_chrdev_region(devno, aesd_nr_devs);
 }
 
 module_init(aesd_init_module);
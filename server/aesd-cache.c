@@ -0,0 +1,226 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-cache.c)
+ * @File Description: (process-wide in-memory copy of the aesdsocket data file, replies are sent from refcounted snapshots)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "aesd-cache.h"
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER; // serializes appends and taking new snapshots
+static cache_buffer_t *cache_current = NULL;				   // buffer appended to, NULL when disabled
+static size_t cache_len = 0;								   // published history size
+static atomic_uint_fast64_t cache_gen = 0;					   // bumped by every append
+
+// last snapshot taken by this thread, reused while no append happened
+static __thread cache_snapshot_t cache_local;
+static pthread_key_t cache_local_key; // releases cache_local when its thread exits
+static bool cache_enabled = false;	  // cache_init succeeded, set before the server threads start
+
+/*
+ * @function	:  Release the snapshot kept by an exiting thread
+ *
+ * @param		:  void *local : cache_local of the thread
+ * @return		:  NULL
+ *
+ */
+static void cache_local_exit(void *local)
+{
+	cache_release(local);
+}
+
+/*
+ * @function	:  Drop one reference of a buffer, the last one frees it
+ *
+ * @param		:  cache_buffer_t *buffer : buffer to release
+ * @return		:  NULL
+ *
+ */
+static void cache_buffer_put(cache_buffer_t *buffer)
+{
+	if (atomic_fetch_sub_explicit(&buffer->refs, 1, memory_order_acq_rel) == 1)
+		free(buffer);
+}
+
+/*
+ * @function	:  Start an empty cache, the data file must be empty as well
+ *
+ * @param		:  NULL
+ * @return		:  0 on success, -1 when the buffer could not be allocated
+ *
+ */
+int cache_init(void)
+{
+	if (pthread_key_create(&cache_local_key, cache_local_exit) != 0)
+		return -1;
+	cache_current = malloc(sizeof(cache_buffer_t) + CACHE_INITIAL_SIZE);
+	if (cache_current == NULL)
+	{
+		pthread_key_delete(cache_local_key);
+		return -1;
+	}
+	atomic_init(&cache_current->refs, 1);
+	cache_current->size = CACHE_INITIAL_SIZE;
+	cache_len = 0;
+	cache_enabled = true;
+	return 0;
+}
+
+/*
+ * @function	:  Append the bytes just written to the data file and publish them as a new generation.
+ * 				   Past CACHE_MAX_SIZE, or when growing fails, the cache is disabled for good
+ *
+ * @param		:  const struct iovec *iov : bytes appended to the file, int iov_count : number of iov
+ * @return		:  NULL
+ *
+ */
+void cache_append(const struct iovec *iov, int iov_count)
+{
+	size_t append_len = 0;
+
+	for (int i = 0; i < iov_count; i++)
+		append_len += iov[i].iov_len;
+
+	pthread_mutex_lock(&cache_lock);
+	if (cache_current != NULL && cache_len + append_len > cache_current->size)
+	{
+		size_t size = cache_current->size;
+		cache_buffer_t *grown = NULL;
+
+		while (size < cache_len + append_len)
+			size *= 2;
+		if (size <= CACHE_MAX_SIZE)
+			grown = malloc(sizeof(cache_buffer_t) + size);
+		if (grown != NULL)
+		{
+			atomic_init(&grown->refs, 1);
+			grown->size = size;
+			memcpy(grown->data, cache_current->data, cache_len);
+		}
+		// snapshots of the old buffer stay valid until released
+		cache_buffer_put(cache_current);
+		cache_current = grown;
+	}
+	if (cache_current != NULL)
+	{
+		// past cache_len, no snapshot can see these bytes yet
+		for (int i = 0; i < iov_count; i++)
+		{
+			memcpy(cache_current->data + cache_len, iov[i].iov_base, iov[i].iov_len);
+			cache_len += iov[i].iov_len;
+		}
+	}
+	atomic_fetch_add_explicit(&cache_gen, 1, memory_order_release);
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/*
+ * @function	:  Current generation, the number of appends so far
+ *
+ * @param		:  NULL
+ * @return		:  generation
+ *
+ */
+uint64_t cache_generation(void)
+{
+	return atomic_load_explicit(&cache_gen, memory_order_acquire);
+}
+
+/*
+ * @function	:  Take a snapshot of the whole history. While the generation has not changed since the
+ * 				   calling thread's previous snapshot, that one is shared again without taking the lock
+ *
+ * @param		:  cache_snapshot_t *snapshot : filled in, to be passed to cache_release
+ * @return		:  true with a snapshot, false when the cache is disabled or cache_init failed
+ *
+ */
+bool cache_acquire(cache_snapshot_t *snapshot)
+{
+	uint64_t generation = cache_generation();
+
+	// without cache_init the thread key does not exist
+	if (!cache_enabled)
+	{
+		snapshot->buffer = NULL;
+		return false;
+	}
+	if (cache_local.buffer == NULL || cache_local.generation != generation)
+	{
+		if (cache_local.buffer == NULL)
+			pthread_setspecific(cache_local_key, &cache_local);
+		cache_release(&cache_local);
+		pthread_mutex_lock(&cache_lock);
+		if (cache_current != NULL)
+		{
+			atomic_fetch_add_explicit(&cache_current->refs, 1, memory_order_relaxed);
+			cache_local.buffer = cache_current;
+			cache_local.data = cache_current->data;
+			cache_local.len = cache_len;
+			cache_local.generation = atomic_load_explicit(&cache_gen, memory_order_relaxed);
+		}
+		pthread_mutex_unlock(&cache_lock);
+		if (cache_local.buffer == NULL)
+		{
+			snapshot->buffer = NULL;
+			return false;
+		}
+	}
+	// the thread keeps its own reference, the caller gets another one
+	atomic_fetch_add_explicit(&cache_local.buffer->refs, 1, memory_order_relaxed);
+	*snapshot = cache_local;
+	return true;
+}
+
+/*
+ * @function	:  Release a snapshot taken by cache_acquire, also fine on one that was not taken
+ *
+ * @param		:  cache_snapshot_t *snapshot : snapshot to release, cleared
+ * @return		:  NULL
+ *
+ */
+void cache_release(cache_snapshot_t *snapshot)
+{
+	if (snapshot->buffer != NULL)
+	{
+		cache_buffer_put(snapshot->buffer);
+		snapshot->buffer = NULL;
+	}
+}
+
+/*
+ * @function	:  Allocate a buffer owned by a snapshot alone, for a reply copied from somewhere else
+ * 				   than the history cache. Released with cache_release like a cache snapshot
+ *
+ * @param		:  cache_snapshot_t *snapshot : filled in with the buffer, size_t size : bytes to allocate
+ * @return		:  the bytes to fill, NULL when the allocation failed
+ *
+ */
+char *cache_private(cache_snapshot_t *snapshot, size_t size)
+{
+	cache_buffer_t *buffer = malloc(sizeof(cache_buffer_t) + size);
+
+	snapshot->buffer = buffer;
+	if (buffer == NULL)
+		return NULL;
+	atomic_init(&buffer->refs, 1);
+	buffer->size = size;
+	snapshot->data = buffer->data;
+	snapshot->len = size;
+	snapshot->generation = 0;
+	return buffer->data;
+}
+
+/*
+ * @function	:  Take another reference of a snapshot for a second holder, each one is released with cache_release
+ *
+ * @param		:  const cache_snapshot_t *from : snapshot holding a buffer, cache_snapshot_t *to : filled in
+ * @return		:  NULL
+ *
+ */
+void cache_share(const cache_snapshot_t *from, cache_snapshot_t *to)
+{
+	atomic_fetch_add_explicit(&from->buffer->refs, 1, memory_order_relaxed);
+	*to = *from;
+}
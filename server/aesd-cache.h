@@ -0,0 +1,55 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-cache.h)
+ * @File Description: (process-wide in-memory copy of the aesdsocket data file, replies are sent from refcounted snapshots)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#ifndef AESD_CACHE_H
+#define AESD_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+
+#define CACHE_INITIAL_SIZE (64 * 1024)	// first buffer, doubled whenever an append does not fit
+#define CACHE_MAX_SIZE (64UL << 20)		// history beyond this is no longer cached, replies read the file again
+
+/**
+ * Append-only buffer holding the history, the bytes below the published length never change.
+ * Replaced by a larger copy when full, the old one lives until its last snapshot is released
+ */
+typedef struct
+{
+	atomic_uint refs; // snapshots plus one for being the current buffer
+	size_t size;	  // allocated bytes of data
+	char data[];
+} cache_buffer_t;
+
+/**
+ * Immutable view of the history at one generation, valid until cache_release
+ */
+typedef struct
+{
+	cache_buffer_t *buffer; // NULL when the cache is not in use
+	const char *data;		// start of the history
+	size_t len;				// history size at generation
+	uint64_t generation;	// appends applied when the snapshot was taken
+} cache_snapshot_t;
+
+extern int cache_init(void);
+
+extern void cache_append(const struct iovec *iov, int iov_count);
+
+extern uint64_t cache_generation(void);
+
+extern bool cache_acquire(cache_snapshot_t *snapshot);
+
+extern void cache_release(cache_snapshot_t *snapshot);
+
+extern char *cache_private(cache_snapshot_t *snapshot, size_t size);
+
+extern void cache_share(const cache_snapshot_t *from, cache_snapshot_t *to);
+
+#endif /* AESD_CACHE_H */
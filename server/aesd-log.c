@@ -0,0 +1,339 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-log.c)
+ * @File Description: (asynchronous logger of aesdsocket: per-thread lock-free rings drained to syslog by a flusher thread)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include "aesd-log.h"
+
+#define LOG_CACHE_LINE_SIZE (64)
+
+// One queued message
+typedef struct
+{
+	uint8_t priority;
+	uint8_t reserved;
+	uint16_t len; // bytes of text, not terminated
+	char text[LOG_RECORD_SIZE - 4];
+} log_record_t;
+
+// Single producer, single consumer ring of one thread. The owner only writes head, the flusher only tail
+typedef struct log_ring_s
+{
+	_Alignas(LOG_CACHE_LINE_SIZE) atomic_uint head; // next record the owner fills
+	time_t rate_second;								// owner only: second the rate count belongs to
+	unsigned rate_count;							// owner only: records queued in rate_second
+	_Alignas(LOG_CACHE_LINE_SIZE) atomic_uint tail; // next record the flusher takes
+	atomic_ulong dropped;							// records lost to a full ring or the rate limit
+	atomic_bool orphaned;							// owner exited, freed by the flusher once drained
+	struct log_ring_s *next;						// all rings, new ones are pushed at the head
+	log_record_t records[LOG_RING_RECORDS];
+} log_ring_t;
+
+static _Atomic(log_ring_t *) logger_rings = NULL; // rings of every thread that logged
+static __thread log_ring_t *logger_ring = NULL;	  // ring of the calling thread
+static pthread_key_t logger_key;				  // marks the ring orphaned when its thread exits
+static pthread_once_t logger_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t logger_drain_lock = PTHREAD_MUTEX_INITIALIZER; // one consumer at a time
+static bool logger_console = false;									  // records are echoed to stderr
+static atomic_bool logger_running = false;							  // the flusher thread was started
+static atomic_uint logger_flush_asked = 0;							  // flushes requested by logger_flush_request
+static atomic_uint logger_flush_served = 0;							  // requests the flusher drained the rings for
+static _Atomic(const char *) logger_flush_message = NULL;			  // logged by the flusher for a request
+
+/*
+ * @function	:  Hand the ring of an exiting thread over to the flusher
+ *
+ * @param		:  void *ring : log_ring_t of the thread
+ * @return		:  NULL
+ *
+ */
+static void logger_ring_orphan(void *ring)
+{
+	logger_ring = NULL; // a later destructor logging gets a fresh ring
+	atomic_store_explicit(&((log_ring_t *)ring)->orphaned, true, memory_order_release);
+}
+
+/*
+ * @function	:  Create the key releasing the rings of exiting threads
+ *
+ * @param		:  NULL
+ * @return		:  NULL
+ *
+ */
+static void logger_key_create(void)
+{
+	pthread_key_create(&logger_key, logger_ring_orphan);
+}
+
+/*
+ * @function	:  Ring of the calling thread, allocated and published on its first message
+ *
+ * @param		:  NULL
+ * @return		:  the ring, NULL when it could not be allocated
+ *
+ */
+static log_ring_t *logger_ring_get(void)
+{
+	log_ring_t *ring = logger_ring;
+
+	if (ring != NULL)
+		return ring;
+	pthread_once(&logger_key_once, logger_key_create);
+	ring = aligned_alloc(LOG_CACHE_LINE_SIZE, sizeof(log_ring_t));
+	if (ring == NULL)
+		return NULL;
+	memset(ring, 0, sizeof(log_ring_t));
+	ring->next = atomic_load_explicit(&logger_rings, memory_order_relaxed);
+	while (!atomic_compare_exchange_weak_explicit(&logger_rings, &ring->next, ring, memory_order_release, memory_order_relaxed))
+		;
+	pthread_setspecific(logger_key, ring);
+	logger_ring = ring;
+	return ring;
+}
+
+/*
+ * @function	:  Format a message into the ring of the calling thread, used through AESD_LOG
+ *
+ * @param		:  int priority : syslog priority, const char *format : printf format and its arguments
+ * @return		:  NULL
+ *
+ */
+void logger_write(int priority, const char *format, ...)
+{
+	log_ring_t *ring = logger_ring_get();
+	struct timespec now;
+	va_list args;
+
+	if (ring == NULL)
+		return;
+	// the coarse clock is read from the vDSO, no system call
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+	if (now.tv_sec != ring->rate_second)
+	{
+		ring->rate_second = now.tv_sec;
+		ring->rate_count = 0;
+	}
+	unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (ring->rate_count >= LOG_RATE_PER_SEC ||
+		head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= LOG_RING_RECORDS)
+	{
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+		return;
+	}
+	ring->rate_count++;
+
+	log_record_t *record = &ring->records[head & (LOG_RING_RECORDS - 1)];
+	va_start(args, format);
+	int len = vsnprintf(record->text, sizeof(record->text), format, args);
+	va_end(args);
+	if (len < 0)
+		len = 0;
+	if ((size_t)len >= sizeof(record->text))
+		len = sizeof(record->text) - 1;
+	// several messages carry a newline from their printf days, syslog does not want it
+	while (len > 0 && record->text[len - 1] == '\n')
+		len--;
+	record->priority = priority;
+	record->len = len;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/*
+ * @function	:  Write one message to syslog, and to stderr when running in the foreground
+ *
+ * @param		:  int priority : syslog priority, const char *text : message, int len : its size
+ * @return		:  NULL
+ *
+ */
+static void logger_emit(int priority, const char *text, int len)
+{
+	syslog(priority, "%.*s", len, text);
+	if (logger_console)
+		fprintf(stderr, "%.*s\n", len, text);
+}
+
+/*
+ * @function	:  Take a ring out of the list, only the consumer unlinks so only the head can change meanwhile
+ *
+ * @param		:  log_ring_t *prev : ring before it as seen by the consumer, NULL at the head, log_ring_t *ring : ring to remove
+ * @return		:  NULL
+ *
+ */
+static void logger_ring_unlink(log_ring_t *prev, log_ring_t *ring)
+{
+	log_ring_t *expected = ring;
+
+	if (prev == NULL && atomic_compare_exchange_strong(&logger_rings, &expected, ring->next))
+		return;
+	// new rings were pushed in front of it
+	if (prev == NULL)
+	{
+		prev = expected;
+		while (prev->next != ring)
+			prev = prev->next;
+	}
+	prev->next = ring->next;
+}
+
+/*
+ * @function	:  Write out every queued record and free the rings of exited threads
+ *
+ * @param		:  NULL
+ * @return		:  number of records written
+ *
+ */
+static int logger_drain(void)
+{
+	log_ring_t *prev = NULL;
+	log_ring_t *ring = atomic_load_explicit(&logger_rings, memory_order_acquire);
+	int count = 0;
+
+	while (ring != NULL)
+	{
+		// read before draining, an orphaned ring gets no further records
+		bool orphaned = atomic_load_explicit(&ring->orphaned, memory_order_acquire);
+		unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+		for (; tail != head; tail++, count++)
+		{
+			log_record_t *record = &ring->records[tail & (LOG_RING_RECORDS - 1)];
+			logger_emit(record->priority, record->text, record->len);
+		}
+		atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+		unsigned long dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+		if (dropped > 0)
+		{
+			char text[64];
+			int len = snprintf(text, sizeof(text), "%lu log messages dropped", dropped);
+			logger_emit(LOG_WARNING, text, len);
+		}
+
+		log_ring_t *next = ring->next;
+		if (orphaned)
+		{
+			logger_ring_unlink(prev, ring);
+			free(ring);
+		}
+		else
+		{
+			prev = ring;
+		}
+		ring = next;
+	}
+	return count;
+}
+
+/*
+ * @function	:  Flusher thread, drains the rings and sleeps LOG_FLUSH_INTERVAL_MS whenever they are empty
+ *
+ * @param		:  void *thread_parameter : unused
+ * @return		:  NULL
+ *
+ */
+static void *logger_flusher(void *thread_parameter)
+{
+	struct timespec interval = {.tv_sec = 0, .tv_nsec = LOG_FLUSH_INTERVAL_MS * 1000000L};
+
+	while (1)
+	{
+		unsigned asked = atomic_load_explicit(&logger_flush_asked, memory_order_acquire);
+		pthread_mutex_lock(&logger_drain_lock);
+		int count = logger_drain();
+		pthread_mutex_unlock(&logger_drain_lock);
+		if (count > 0)
+			continue;
+		// a pass that found nothing started after the requests read above, they are served
+		if (asked != atomic_load_explicit(&logger_flush_served, memory_order_relaxed))
+		{
+			const char *message = atomic_exchange_explicit(&logger_flush_message, NULL, memory_order_acquire);
+			if (message != NULL)
+				logger_emit(LOG_DEBUG, message, strlen(message));
+			atomic_store_explicit(&logger_flush_served, asked, memory_order_release);
+		}
+		else
+			nanosleep(&interval, NULL);
+	}
+	return NULL;
+}
+
+/*
+ * @function	:  Start the flusher thread, messages queued before are written on its first pass
+ *
+ * @param		:  bool console : also echo the messages to stderr
+ * @return		:  0 on success, -1 when the thread could not be created
+ *
+ */
+int logger_start(bool console)
+{
+	pthread_t flusher;
+	sigset_t all_signals;
+	sigset_t old_signals;
+
+	logger_console = console;
+	// the flusher inherits a full signal mask, so a signal handler waiting for it never runs on it
+	sigfillset(&all_signals);
+	pthread_sigmask(SIG_SETMASK, &all_signals, &old_signals);
+	int ret = pthread_create(&flusher, NULL, logger_flusher, NULL);
+	pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+	if (ret != 0)
+		return -1;
+	pthread_detach(flusher);
+	atomic_store_explicit(&logger_running, true, memory_order_release);
+	atexit(logger_flush);
+	return 0;
+}
+
+/*
+ * @function	:  Have the flusher thread write out the messages queued so far, then message, and wait for
+ * 				   it, at most LOG_FLUSH_WAIT_MS. Only touches atomics and sleeps, so it may be called from
+ * 				   a signal handler about to _exit
+ *
+ * @param		:  const char *message : constant text logged at LOG_DEBUG after the queued ones, or NULL
+ * @return		:  NULL
+ *
+ */
+void logger_flush_request(const char *message)
+{
+	struct timespec step = {.tv_sec = 0, .tv_nsec = 1000000L};
+
+	if (!atomic_load_explicit(&logger_running, memory_order_acquire))
+		return;
+	if (message != NULL)
+		atomic_store_explicit(&logger_flush_message, message, memory_order_release);
+	unsigned asked = atomic_fetch_add_explicit(&logger_flush_asked, 1, memory_order_release) + 1;
+	for (int waited = 0; waited < LOG_FLUSH_WAIT_MS; waited++)
+	{
+		if ((int)(atomic_load_explicit(&logger_flush_served, memory_order_acquire) - asked) >= 0)
+			return;
+		nanosleep(&step, NULL);
+	}
+}
+
+/*
+ * @function	:  Write out the queued messages now, before exiting. Skipped while the flusher is
+ * 				   draining. Takes locks and calls syslog, so not for signal handlers, see logger_flush_request
+ *
+ * @param		:  NULL
+ * @return		:  NULL
+ *
+ */
+void logger_flush(void)
+{
+	if (pthread_mutex_trylock(&logger_drain_lock) != 0)
+		return;
+	logger_drain();
+	pthread_mutex_unlock(&logger_drain_lock);
+}
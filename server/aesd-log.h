@@ -0,0 +1,44 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-log.h)
+ * @File Description: (asynchronous logger of aesdsocket: per-thread lock-free rings drained to syslog by a flusher thread)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#ifndef AESD_LOG_H
+#define AESD_LOG_H
+
+#include <stdbool.h>
+#include <syslog.h>
+
+// Least severe syslog priority compiled in, calls below it and their arguments are removed by the compiler.
+// Build with "make AESD_LOG_LEVEL=LOG_INFO" to drop the per-packet debug messages
+#ifndef AESD_LOG_LEVEL
+#define AESD_LOG_LEVEL LOG_DEBUG
+#endif
+
+#define LOG_RECORD_SIZE (256)	  // bytes of one record including its header, longer messages are cut
+#define LOG_RING_RECORDS (128)	  // records per thread ring, a power of two
+#define LOG_RATE_PER_SEC (1000)	  // records a thread may queue per second
+#define LOG_FLUSH_INTERVAL_MS (10) // flusher sleep when every ring is empty
+#define LOG_FLUSH_WAIT_MS (100)	   // longest wait of logger_flush_request for the flusher
+
+/**
+ * Queue a message for syslog, priority is one of LOG_EMERG..LOG_DEBUG. Never blocks and never makes a
+ * system call: a full ring or an exceeded rate drops the message and the flusher reports the count
+ */
+#define AESD_LOG(priority, ...)                   \
+	do                                            \
+	{                                             \
+		if ((priority) <= AESD_LOG_LEVEL)         \
+			logger_write((priority), __VA_ARGS__); \
+	} while (0)
+
+extern void logger_write(int priority, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+extern int logger_start(bool console);
+
+extern void logger_flush(void);
+
+extern void logger_flush_request(const char *message);
+
+#endif /* AESD_LOG_H */
@@ -0,0 +1,162 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-metrics.c)
+ * @File Description: (per-CPU runtime counters and latency histogram of aesdsocket, dumped as text over a Unix-domain socket)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "aesd-metrics.h"
+
+#define METRICS_TEXT_SIZE (4096)
+
+metrics_slot_t metrics_slots[METRICS_MAX_CPUS];
+
+static int metrics_fd = -1; // listening Unix-domain socket
+
+static const char *metric_names[METRIC_COUNT] = {
+	[METRIC_ACCEPTED] = "connections_accepted",
+	[METRIC_BYTES_IN] = "bytes_in",
+	[METRIC_BYTES_OUT] = "bytes_out",
+	[METRIC_PACKETS] = "packets",
+	[METRIC_SEEKS] = "ioctl_seeks",
+	[METRIC_CLIENTS] = "active_connections",
+	[METRIC_THREADS] = "active_threads",
+	[METRIC_QUEUED] = "queue_depth",
+};
+
+/*
+ * @function	:  Current monotonic time in microseconds, start point of a latency sample
+ *
+ * @param		:  NULL
+ * @return		:  microseconds since an arbitrary point
+ *
+ */
+uint64_t metrics_now_us(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/*
+ * @function	:  Record the time from start_us until now in the latency histogram
+ *
+ * @param		:  uint64_t start_us : value of metrics_now_us() when the packet was framed
+ * @return		:  NULL
+ *
+ */
+void metrics_record_latency(uint64_t start_us)
+{
+	uint64_t elapsed = metrics_now_us() - start_us;
+	int bucket = (elapsed == 0) ? 0 : 64 - __builtin_clzll(elapsed);
+
+	if (bucket >= METRICS_LATENCY_BUCKETS)
+		bucket = METRICS_LATENCY_BUCKETS - 1;
+	atomic_fetch_add_explicit(&metrics_slot()->latency[bucket], 1, memory_order_relaxed);
+}
+
+/*
+ * @function	:  Sum the per-CPU slots into a text report, one "name value" per line and a
+ * 				   cumulative latency histogram
+ *
+ * @param		:  char *text : output buffer, size_t size : its size
+ * @return		:  length of the report
+ *
+ */
+static size_t metrics_format(char *text, size_t size)
+{
+	long totals[METRIC_COUNT] = {0};
+	unsigned long latency[METRICS_LATENCY_BUCKETS] = {0};
+	unsigned long cumulative = 0;
+	size_t len = 0;
+
+	for (int cpu = 0; cpu < METRICS_MAX_CPUS; cpu++)
+	{
+		for (int i = 0; i < METRIC_COUNT; i++)
+			totals[i] += atomic_load_explicit(&metrics_slots[cpu].counters[i], memory_order_relaxed);
+		for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++)
+			latency[i] += atomic_load_explicit(&metrics_slots[cpu].latency[i], memory_order_relaxed);
+	}
+
+	for (int i = 0; i < METRIC_COUNT && len < size; i++)
+		len += snprintf(text + len, size - len, "%s %ld\n", metric_names[i], totals[i]);
+	for (int i = 0; i < METRICS_LATENCY_BUCKETS && len < size; i++)
+	{
+		cumulative += latency[i];
+		len += snprintf(text + len, size - len, "latency_us_bucket{le=\"%lu\"} %lu\n", (1UL << i) - 1, cumulative);
+	}
+	if (len < size)
+		len += snprintf(text + len, size - len, "latency_us_count %lu\n", cumulative);
+	return (len < size) ? len : size - 1;
+}
+
+/*
+ * @function	:  Metrics thread, answers every connection on the Unix-domain socket with one report
+ *
+ * @param		:  void *thread_parameter : unused
+ * @return		:  NULL
+ *
+ */
+static void *metrics_handler(void *thread_parameter)
+{
+	char text[METRICS_TEXT_SIZE];
+
+	while (1)
+	{
+		int client_fd = accept(metrics_fd, NULL, NULL);
+		if (client_fd == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			syslog(LOG_ERR, "Error: metrics accept failed =%s", strerror(errno));
+			return NULL;
+		}
+		size_t len = metrics_format(text, sizeof(text));
+		if (send(client_fd, text, len, MSG_NOSIGNAL) == -1)
+			syslog(LOG_DEBUG, "metrics client went away");
+		close(client_fd);
+	}
+	return NULL;
+}
+
+/*
+ * @function	:  Listen on a Unix-domain socket at path and serve the report from a detached thread
+ *
+ * @param		:  const char *path : socket path, replaced if it exists
+ * @return		:  0 on success, -1 on error
+ *
+ */
+int metrics_start(const char *path)
+{
+	struct sockaddr_un addr;
+	pthread_t thread_id;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	metrics_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (metrics_fd == -1)
+		return -1;
+	unlink(path);
+	if (bind(metrics_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(metrics_fd, 4) == -1)
+		return -1;
+	if (pthread_create(&thread_id, NULL, metrics_handler, NULL) != 0)
+		return -1;
+	pthread_detach(thread_id);
+	return 0;
+}
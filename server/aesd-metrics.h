@@ -0,0 +1,69 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-metrics.h)
+ * @File Description: (per-CPU runtime counters and latency histogram of aesdsocket, dumped as text over a Unix-domain socket)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#ifndef AESD_METRICS_H
+#define AESD_METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#define METRICS_CACHE_LINE_SIZE (64)
+#define METRICS_MAX_CPUS (64)		   // CPUs beyond this share slots
+#define METRICS_LATENCY_BUCKETS (32) // bucket i counts latencies below 2^i microseconds
+
+/**
+ * Counters and gauges, gauges are summed from increments and decrements on any CPU
+ */
+typedef enum
+{
+	METRIC_ACCEPTED = 0, // connections accepted
+	METRIC_BYTES_IN,	 // bytes received from clients
+	METRIC_BYTES_OUT,	 // reply bytes sent to clients
+	METRIC_PACKETS,		 // packets applied
+	METRIC_SEEKS,		 // AESDCHAR_IOCSEEKTO commands applied
+	METRIC_CLIENTS,		 // gauge: connections being served
+	METRIC_THREADS,		 // gauge: connection, worker and reactor threads running
+	METRIC_QUEUED,		 // gauge: accepted connections waiting in the pool queue
+	METRIC_COUNT,
+} metric_t;
+
+/**
+ * Counters of one CPU, aligned so that two CPUs never write the same cache line
+ */
+typedef struct
+{
+	_Alignas(METRICS_CACHE_LINE_SIZE) atomic_long counters[METRIC_COUNT];
+	atomic_ulong latency[METRICS_LATENCY_BUCKETS];
+} metrics_slot_t;
+
+extern metrics_slot_t metrics_slots[METRICS_MAX_CPUS];
+
+/**
+ * @return the slot of the CPU the caller runs on, threads migrating between CPUs only
+ * cost an occasional shared cache line
+ */
+static inline metrics_slot_t *metrics_slot(void)
+{
+	int cpu = sched_getcpu();
+	return &metrics_slots[(cpu < 0 ? 0 : cpu) % METRICS_MAX_CPUS];
+}
+
+/**
+ * Add value to a counter or gauge without any lock or shared cache line
+ */
+static inline void metrics_add(metric_t metric, long value)
+{
+	atomic_fetch_add_explicit(&metrics_slot()->counters[metric], value, memory_order_relaxed);
+}
+
+extern uint64_t metrics_now_us(void);
+
+extern void metrics_record_latency(uint64_t start_us);
+
+extern int metrics_start(const char *path);
+
+#endif /* AESD_METRICS_H */
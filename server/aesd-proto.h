@@ -0,0 +1,87 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-proto.h)
+ * @File Description: (wire format of the length-prefixed binary protocol of aesdsocket, next to the newline protocol)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#ifndef AESD_PROTO_H
+#define AESD_PROTO_H
+
+#include <stdint.h>
+
+/**
+ * A connection whose first bytes are PROTO_MAGIC speaks the binary protocol for the rest of its life,
+ * anything else is handled as newline terminated packets. The magic is not valid text, a text client
+ * never starts with it
+ */
+#define PROTO_MAGIC "\xae\x5d\x00\x01"
+#define PROTO_MAGIC_LEN (4)
+
+#define PROTO_MAX_PAYLOAD (64UL << 20) // larger requests close the connection
+
+/**
+ * Request opcodes, every request gets exactly one reply
+ */
+typedef enum
+{
+	PROTO_OP_APPEND = 1, // payload is appended to the history as it is, like one write()
+	PROTO_OP_SEEKTO = 2, // payload is a proto_seekto_t, moves the file position with AESDCHAR_IOCSEEKTO
+	PROTO_OP_READ = 3,	 // payload is a proto_read_t, the reply carries the requested range of the history
+} proto_opcode_t;
+
+/**
+ * Reply status
+ */
+typedef enum
+{
+	PROTO_STATUS_OK = 0,
+	PROTO_STATUS_BAD_REQUEST = 1, // unknown opcode or malformed payload
+	PROTO_STATUS_UNSUPPORTED = 2, // the backend cannot do it, seekto on the file backend
+	PROTO_STATUS_FAILED = 3,	  // the backend refused it, seekto past the history
+} proto_status_t;
+
+/**
+ * Request header, followed by length bytes of payload. Multi-byte fields are in network byte order
+ */
+typedef struct __attribute__((packed))
+{
+	uint8_t opcode;	  // proto_opcode_t
+	uint8_t flags;	  // must be 0
+	uint16_t reserved;
+	uint32_t length;  // payload bytes, at most PROTO_MAX_PAYLOAD
+} proto_header_t;
+
+/**
+ * Payload of PROTO_OP_SEEKTO, see struct aesd_seekto
+ */
+typedef struct __attribute__((packed))
+{
+	uint32_t write_cmd;
+	uint32_t write_cmd_offset;
+} proto_seekto_t;
+
+#define PROTO_READ_CURRENT UINT64_MAX // offset of a read starting at the file position
+
+/**
+ * Payload of PROTO_OP_READ. The file position of the connection ends after the bytes sent, so
+ * consecutive reads from PROTO_READ_CURRENT stream the history
+ */
+typedef struct __attribute__((packed))
+{
+	uint64_t offset; // first byte, PROTO_READ_CURRENT for the file position
+	uint64_t length; // bytes wanted, 0 until the end of the history
+} proto_read_t;
+
+/**
+ * Reply header, followed by length bytes of history for PROTO_OP_READ
+ */
+typedef struct __attribute__((packed))
+{
+	uint8_t opcode; // opcode of the request
+	uint8_t status; // proto_status_t
+	uint16_t reserved;
+	uint32_t reserved2;
+	uint64_t length; // bytes following the header
+} proto_reply_t;
+
+#endif /* AESD_PROTO_H */
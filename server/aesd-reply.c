@@ -0,0 +1,302 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-reply.c)
+ * @File Description: (zero copy send back of the aesdsocket data file using sendfile/splice with a read/send fallback)
+ * @Author Name (AYSWARIYA KANNAN)
+ * @Attributions :https://man7.org/linux/man-pages/man2/sendfile.2.html
+ * 				  https://man7.org/linux/man-pages/man2/splice.2.html
+ **************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include "aesd-reply.h"
+
+/*
+ * @function	:  Prepare sending data_fd from its current position, picking the method when
+ * 				   REPLY_AUTO is requested
+ *
+ * @param		:  reply_state_t *reply : state to initialize, int data_fd : file to send,
+ * 				   reply_method_t method : requested method
+ * @return		:  NULL
+ *
+ */
+void reply_start(reply_state_t *reply, int data_fd, reply_method_t method)
+{
+	struct stat data_stat;
+
+	reply->data_fd = data_fd;
+	reply->started = false;
+	reply->pipe_fd[0] = reply->pipe_fd[1] = -1;
+	reply->pipe_len = 0;
+	reply->tx_len = reply->tx_sent = 0;
+	reply->head_len = reply->head_sent = 0;
+	reply->limit = SIZE_MAX;
+	reply->exact = false;
+	reply->sent = 0;
+
+	if (method == REPLY_AUTO)
+	{
+		// the page cache of a regular file can go to the socket directly
+		if (fstat(data_fd, &data_stat) == 0 && S_ISREG(data_stat.st_mode))
+			method = REPLY_SENDFILE;
+		else
+			method = REPLY_SPLICE;
+	}
+	if (method == REPLY_SPLICE && pipe2(reply->pipe_fd, O_CLOEXEC) == -1)
+	{
+		reply->pipe_fd[0] = reply->pipe_fd[1] = -1;
+		method = REPLY_COPY;
+	}
+	reply->method = method;
+}
+
+/*
+ * @function	:  Prepare sending len bytes of history that are already mapped in memory
+ *
+ * @param		:  reply_state_t *reply : state to initialize, const char *data : start of the reply,
+ * 				   size_t len : size of the reply
+ * @return		:  NULL
+ *
+ */
+void reply_start_memory(reply_state_t *reply, const char *data, size_t len)
+{
+	reply->data_fd = -1;
+	reply->method = REPLY_MEMORY;
+	reply->started = true;
+	reply->pipe_fd[0] = reply->pipe_fd[1] = -1;
+	reply->pipe_len = 0;
+	reply->tx_len = reply->tx_sent = 0;
+	reply->head_len = reply->head_sent = 0;
+	reply->limit = SIZE_MAX;
+	reply->exact = false;
+	reply->sent = 0;
+	reply->mem = data;
+	reply->mem_len = len;
+}
+
+/*
+ * @function	:  Send a header ahead of the data, after reply_start or reply_start_memory
+ *
+ * @param		:  reply_state_t *reply : reply not sent yet, const void *head : header,
+ * 				   size_t len : its size, at most REPLY_HEAD_SIZE
+ * @return		:  NULL
+ *
+ */
+void reply_set_head(reply_state_t *reply, const void *head, size_t len)
+{
+	if (len > REPLY_HEAD_SIZE)
+		len = REPLY_HEAD_SIZE;
+	memcpy(reply->head, head, len);
+	reply->head_len = len;
+	reply->head_sent = 0;
+}
+
+/*
+ * @function	:  Stop after limit bytes of data instead of at end of file, after reply_start or
+ * 				   reply_start_memory. A reply announcing its length must not send what was appended since,
+ * 				   nor end early when history is evicted meanwhile, reply_send then fails with ENODATA
+ *
+ * @param		:  reply_state_t *reply : reply not sent yet, size_t limit : data bytes to send
+ * @return		:  NULL
+ *
+ */
+void reply_set_limit(reply_state_t *reply, size_t limit)
+{
+	reply->limit = limit;
+	reply->exact = true;
+	if (reply->method == REPLY_MEMORY && reply->mem_len > limit)
+		reply->mem_len = limit;
+}
+
+/*
+ * @function	:  Result of reaching end of file, an error when the length announced was not sent
+ *
+ * @param		:  reply_state_t *reply : reply in progress
+ * @return		:  1 when the reply is complete, -1 with errno ENODATA when it came up short
+ *
+ */
+static int reply_end_of_file(reply_state_t *reply)
+{
+	if (reply->exact && reply->limit > 0)
+	{
+		errno = ENODATA;
+		return -1;
+	}
+	return 1;
+}
+
+/*
+ * @function	:  Check whether a failed sendfile/splice should fall back to copying
+ *
+ * @param		:  reply_state_t *reply : reply in progress
+ * @return		:  true when nothing was sent yet and the file does not support the method
+ *
+ */
+static bool reply_can_fallback(reply_state_t *reply)
+{
+	return !reply->started && (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP);
+}
+
+/*
+ * @function	:  Send the header and then the data file to the client until end of file, the limit or
+ * 				   until the socket would block
+ *
+ * @param		:  reply_state_t *reply : reply in progress, int client_fd : client socket
+ * @return		:  1 when the whole file was sent, 0 when the socket would block, -1 on error
+ *
+ */
+int reply_send(reply_state_t *reply, int client_fd)
+{
+	ssize_t ret = 0;
+
+	// corking the header only pays off when data follows, otherwise it would sit in the socket
+	int more = (reply->limit > 0 && (reply->method != REPLY_MEMORY || reply->mem_len > 0)) ? MSG_MORE : 0;
+	while (reply->head_sent < reply->head_len)
+	{
+		ret = send(client_fd, reply->head + reply->head_sent, reply->head_len - reply->head_sent, MSG_NOSIGNAL | more);
+		if (ret == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		reply->head_sent += ret;
+		reply->sent += ret;
+	}
+
+	while (1)
+	{
+		// memory replies are clamped by reply_set_limit, the other sources stop here
+		size_t chunk = (reply->limit < REPLY_CHUNK_SIZE) ? reply->limit : REPLY_CHUNK_SIZE;
+		if (chunk == 0 && reply->method != REPLY_MEMORY && reply->pipe_len == 0 && reply->tx_sent == reply->tx_len)
+			return 1;
+
+		switch (reply->method)
+		{
+		case REPLY_SENDFILE:
+			ret = sendfile(client_fd, reply->data_fd, NULL, chunk);
+			if (ret == 0)
+				return reply_end_of_file(reply);
+			if (ret == -1)
+			{
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return 0;
+				if (errno == EINTR)
+					continue;
+				if (!reply_can_fallback(reply))
+					return -1;
+				reply->method = REPLY_COPY;
+				continue;
+			}
+			reply->started = true;
+			reply->limit -= ret;
+			reply->sent += ret;
+			break;
+
+		case REPLY_SPLICE:
+			if (reply->pipe_len == 0)
+			{
+				ret = splice(reply->data_fd, NULL, reply->pipe_fd[1], NULL, chunk, SPLICE_F_MOVE);
+				if (ret == 0)
+					return reply_end_of_file(reply);
+				if (ret == -1)
+				{
+					if (errno == EINTR)
+						continue;
+					if (!reply_can_fallback(reply))
+						return -1;
+					reply->method = REPLY_COPY;
+					continue;
+				}
+				reply->pipe_len = ret;
+				reply->limit -= ret;
+				reply->started = true;
+			}
+			ret = splice(reply->pipe_fd[0], NULL, client_fd, NULL, reply->pipe_len, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (ret == -1)
+			{
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return 0;
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			reply->pipe_len -= ret;
+			reply->sent += ret;
+			break;
+
+		case REPLY_MEMORY:
+			if (reply->mem_len == 0)
+				return 1;
+			ret = send(client_fd, reply->mem, reply->mem_len, MSG_NOSIGNAL);
+			if (ret == -1)
+			{
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return 0;
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			reply->mem += ret;
+			reply->mem_len -= ret;
+			reply->sent += ret;
+			break;
+
+		default: // REPLY_COPY
+			if (reply->tx_sent == reply->tx_len)
+			{
+				ret = read(reply->data_fd, reply->tx_buff, (chunk < REPLY_BUFFER_SIZE) ? chunk : REPLY_BUFFER_SIZE);
+				// read until no characters left
+				if (ret == 0)
+					return reply_end_of_file(reply);
+				if (ret == -1)
+				{
+					if (errno == EINTR)
+						continue;
+					return -1;
+				}
+				reply->tx_len = ret;
+				reply->tx_sent = 0;
+				reply->limit -= ret;
+				reply->started = true;
+			}
+			ret = send(client_fd, reply->tx_buff + reply->tx_sent, reply->tx_len - reply->tx_sent, MSG_NOSIGNAL);
+			if (ret == -1)
+			{
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return 0;
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+			reply->tx_sent += ret;
+			reply->sent += ret;
+			break;
+		}
+	}
+}
+
+/*
+ * @function	:  Release the resources of a finished reply, data_fd stays open
+ *
+ * @param		:  reply_state_t *reply : finished reply
+ * @return		:  NULL
+ *
+ */
+void reply_finish(reply_state_t *reply)
+{
+	if (reply->pipe_fd[0] != -1)
+	{
+		close(reply->pipe_fd[0]);
+		close(reply->pipe_fd[1]);
+		reply->pipe_fd[0] = reply->pipe_fd[1] = -1;
+	}
+}
@@ -0,0 +1,64 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-reply.h)
+ * @File Description: (sending the contents of the aesdsocket data file back to a client)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#ifndef AESD_REPLY_H
+#define AESD_REPLY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define REPLY_BUFFER_SIZE (1024)  // bounce buffer of the copy fallback
+#define REPLY_CHUNK_SIZE (65536) // bytes moved per sendfile/splice call
+#define REPLY_HEAD_SIZE (32)	 // largest header sent ahead of the data, see reply_set_head
+
+/**
+ * How the data file reaches the socket
+ */
+typedef enum
+{
+	REPLY_AUTO = 0, // sendfile for regular files, splice for everything else
+	REPLY_COPY,		// read into a bounce buffer, then send
+	REPLY_SENDFILE, // sendfile(2) straight from the page cache
+	REPLY_SPLICE,	// splice(2) through a pipe, for devices without sendfile support
+	REPLY_MEMORY,	// send(2) straight from memory already holding the history, see reply_start_memory
+} reply_method_t;
+
+/**
+ * State of one reply in progress, kept across calls when the socket is non-blocking
+ */
+typedef struct
+{
+	int data_fd;		   // source, read from its current file position
+	reply_method_t method; // method in use, never REPLY_AUTO after reply_start
+	bool started;		   // bytes already moved, falling back is no longer possible
+	int pipe_fd[2];		   // splice pipe, -1 when unused
+	size_t pipe_len;	   // bytes sitting in the pipe not sent yet
+	char tx_buff[REPLY_BUFFER_SIZE];
+	size_t tx_len;	 // valid bytes in tx_buff
+	size_t tx_sent;	 // bytes of tx_buff already sent
+	const char *mem; // REPLY_MEMORY source
+	size_t mem_len;	 // bytes of mem not sent yet
+	char head[REPLY_HEAD_SIZE];
+	size_t head_len;  // bytes of head sent before the data
+	size_t head_sent; // bytes of head already sent
+	size_t limit;	  // data bytes still to be taken from the source, SIZE_MAX until end of file
+	bool exact;		  // limit was announced to the client, end of file before it fails the reply
+	size_t sent;	  // bytes delivered to the client so far
+} reply_state_t;
+
+extern void reply_start(reply_state_t *reply, int data_fd, reply_method_t method);
+
+extern void reply_start_memory(reply_state_t *reply, const char *data, size_t len);
+
+extern void reply_set_head(reply_state_t *reply, const void *head, size_t len);
+
+extern void reply_set_limit(reply_state_t *reply, size_t limit);
+
+extern int reply_send(reply_state_t *reply, int client_fd);
+
+extern void reply_finish(reply_state_t *reply);
+
+#endif /* AESD_REPLY_H */
@@ -0,0 +1,221 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-uring.c)
+ * @File Description: (minimal io_uring submission and completion rings on the raw system calls, without liburing)
+ * @Author Name (AYSWARIYA KANNAN)
+ * @Attributions :https://man7.org/linux/man-pages/man2/io_uring_setup.2.html
+ * 				  https://man7.org/linux/man-pages/man2/io_uring_enter.2.html
+ * 				  https://kernel.dk/io_uring.pdf
+ **************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "aesd-uring.h"
+
+#define URING_PROBE_OPS (256)
+
+/*
+ * @function	:  Release the mappings and the descriptor of a ring, also of a partially set up one
+ *
+ * @param		:  uring_t *ring : ring to release
+ * @return		:  NULL
+ *
+ */
+void uring_exit(uring_t *ring)
+{
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	if (ring->ring_fd >= 0)
+		close(ring->ring_fd);
+	memset(ring, 0, sizeof(*ring));
+	ring->ring_fd = -1;
+}
+
+/*
+ * @function	:  Create an io_uring instance and map its rings
+ *
+ * @param		:  uring_t *ring : ring to set up, unsigned entries : submission queue size
+ * @return		:  0 on success, -1 with errno set, ENOSYS or EPERM when io_uring is not available
+ *
+ */
+int uring_init(uring_t *ring, unsigned entries)
+{
+	struct io_uring_params params;
+	int saved_errno;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&params, 0, sizeof(params));
+	ring->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->ring_fd == -1)
+		return -1;
+	ring->features = params.features;
+
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	// kernels with IORING_FEAT_SINGLE_MMAP share one mapping between both rings
+	if (ring->features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ring->cq_ring_size > ring->sq_ring_size)
+			ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						 ring->ring_fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED)
+		goto error;
+	if (ring->features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ring = ring->sq_ring;
+	else
+	{
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+							 ring->ring_fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED)
+			goto error;
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  ring->ring_fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto error;
+
+	ring->sq_head = (unsigned *)((char *)ring->sq_ring + params.sq_off.head);
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+	ring->sq_mask = *(unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+	ring->sq_entries = params.sq_entries;
+	ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+	ring->sqe_tail = *ring->sq_tail;
+	ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+	ring->cq_mask = *(unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+
+	// SQEs are always submitted in order, slot i of the indirection array keeps pointing at SQE i
+	for (unsigned i = 0; i < ring->sq_entries; i++)
+		ring->sq_array[i] = i;
+	return 0;
+
+error:
+	saved_errno = errno;
+	uring_exit(ring);
+	errno = saved_errno;
+	return -1;
+}
+
+/*
+ * @function	:  Check that the kernel implements every opcode in ops
+ *
+ * @param		:  uring_t *ring : ring to ask, const uint8_t *ops : IORING_OP_* values, size_t count : number of ops
+ * @return		:  0 when all are supported, -1 with errno set to EOPNOTSUPP or the probe error
+ *
+ */
+int uring_probe(uring_t *ring, const uint8_t *ops, size_t count)
+{
+	struct io_uring_probe *probe;
+	int ret = 0;
+
+	probe = calloc(1, sizeof(struct io_uring_probe) + URING_PROBE_OPS * sizeof(struct io_uring_probe_op));
+	if (probe == NULL)
+		return -1;
+	if (syscall(__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_PROBE, probe, URING_PROBE_OPS) == -1)
+		ret = -1;
+	for (size_t i = 0; ret == 0 && i < count; i++)
+	{
+		if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+		{
+			errno = EOPNOTSUPP;
+			ret = -1;
+		}
+	}
+	free(probe);
+	return ret;
+}
+
+/*
+ * @function	:  Number of SQEs uring_get_sqe can hand out before the next uring_submit
+ *
+ * @param		:  uring_t *ring : ring of the calling thread
+ * @return		:  free entries of the submission ring
+ *
+ */
+unsigned uring_sq_space(uring_t *ring)
+{
+	return ring->sq_entries - (ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE));
+}
+
+/*
+ * @function	:  Hand out the next free SQE, cleared. It is sent to the kernel by the next uring_submit
+ *
+ * @param		:  uring_t *ring : ring of the calling thread
+ * @return		:  SQE to fill in, NULL when the submission ring is full
+ *
+ */
+struct io_uring_sqe *uring_get_sqe(uring_t *ring)
+{
+	unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (ring->sqe_tail - head >= ring->sq_entries)
+		return NULL;
+	sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+	ring->sqe_tail++;
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+/*
+ * @function	:  Publish the SQEs handed out since the last call and submit them with one system call,
+ * 				   optionally waiting for completions
+ *
+ * @param		:  uring_t *ring : ring of the calling thread, unsigned wait_nr : completions to wait for
+ * @return		:  number of SQEs consumed by the kernel, -1 with errno set
+ *
+ */
+int uring_submit(uring_t *ring, unsigned wait_nr)
+{
+	unsigned to_submit;
+
+	// the SQE contents must be visible before the kernel sees the new tail
+	__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	// also resubmit SQEs a previous call left unconsumed
+	to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (to_submit == 0 && wait_nr == 0)
+		return 0;
+	return syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait_nr,
+				   (wait_nr > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+/*
+ * @function	:  Oldest completion not consumed yet, without waiting
+ *
+ * @param		:  uring_t *ring : ring of the calling thread
+ * @return		:  the CQE, NULL when the completion ring is empty
+ *
+ */
+struct io_uring_cqe *uring_peek_cqe(uring_t *ring)
+{
+	unsigned head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+	return &ring->cqes[head & ring->cq_mask];
+}
+
+/*
+ * @function	:  Give the CQE returned by uring_peek_cqe back to the kernel
+ *
+ * @param		:  uring_t *ring : ring of the calling thread
+ * @return		:  NULL
+ *
+ */
+void uring_cqe_seen(uring_t *ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,58 @@
+/**********************************************************************************************************************************
+ * @File name (aesd-uring.h)
+ * @File Description: (minimal io_uring submission and completion rings on the raw system calls, without liburing)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#ifndef AESD_URING_H
+#define AESD_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/**
+ * Rings of one io_uring instance as mapped from the kernel, used by a single thread
+ */
+typedef struct
+{
+	int ring_fd;
+	unsigned features; // IORING_FEAT_* reported by io_uring_setup
+	// submission ring
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned sqe_tail; // SQEs handed out, published to the kernel by uring_submit
+	// completion ring
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_cqe *cqes;
+	// mappings
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+} uring_t;
+
+extern int uring_init(uring_t *ring, unsigned entries);
+
+extern int uring_probe(uring_t *ring, const uint8_t *ops, size_t count);
+
+extern unsigned uring_sq_space(uring_t *ring);
+
+extern struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+
+extern int uring_submit(uring_t *ring, unsigned wait_nr);
+
+extern struct io_uring_cqe *uring_peek_cqe(uring_t *ring);
+
+extern void uring_cqe_seen(uring_t *ring);
+
+extern void uring_exit(uring_t *ring);
+
+#endif /* AESD_URING_H */
@@ -0,0 +1,507 @@
+/**********************************************************************************************************************************
+ * @File name (aesdbench.c)
+ * @File Description: (load generator and latency benchmark for aesdsocket, opens N concurrent connections to port 9000,
+ * 					   sends packets of a configurable size and rate and reports throughput and latency percentiles)
+ * @Author Name (AYSWARIYA KANNAN)
+ * @Attributions :https://github.com/HdrHistogram/HdrHistogram (log-linear bucket layout)
+ **************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define RECV_SIZE (65536)
+#define THREAD_STACK_SIZE (256 * 1024)
+#define HIST_SUB_BITS (4) // 16 linear sub-buckets per power of two, about 6% resolution
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB_COUNT)
+
+/*** OPTIONS *********************************************/
+const char *server_host = "127.0.0.1";
+const char *server_port = "9000";
+int connections = 16;		// concurrent clients
+size_t packet_size = 64;	// bytes per packet including the newline
+long packets = 1000;		// packets sent by every client
+double rate = 0;			// packets per second per client, 0 sends back to back
+bool keepalive = false;		// all packets of a client on one connection, server started with -k
+struct addrinfo *server_addr;
+
+// Latency histogram in microseconds, log-linear buckets
+typedef struct
+{
+	uint64_t counts[HIST_BUCKETS];
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+} histogram_t;
+
+// Per-client state and results
+typedef struct
+{
+	pthread_t thread_id;
+	int id;
+	histogram_t hist;
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	uint64_t errors;
+} client_t;
+
+/*
+ * @function	:  Current monotonic time in nanoseconds
+ *
+ * @param		:  NULL
+ * @return		:  nanoseconds since an arbitrary point
+ *
+ */
+static uint64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * @function	:  Bucket index of a value, values below HIST_SUB_COUNT get exact buckets
+ *
+ * @param		:  uint64_t value : latency in microseconds
+ * @return		:  bucket index
+ *
+ */
+static int hist_index(uint64_t value)
+{
+	if (value < HIST_SUB_COUNT)
+		return value;
+	int msb = 63 - __builtin_clzll(value);
+	int shift = msb - HIST_SUB_BITS;
+	return (shift + 1) * HIST_SUB_COUNT + ((value >> shift) & (HIST_SUB_COUNT - 1));
+}
+
+/*
+ * @function	:  Lowest value falling into a bucket
+ *
+ * @param		:  int index : bucket index
+ * @return		:  latency in microseconds
+ *
+ */
+static uint64_t hist_value(int index)
+{
+	if (index < HIST_SUB_COUNT)
+		return index;
+	int shift = index / HIST_SUB_COUNT - 1;
+	return (uint64_t)(HIST_SUB_COUNT + index % HIST_SUB_COUNT) << shift;
+}
+
+/*
+ * @function	:  Add one sample to a histogram
+ *
+ * @param		:  histogram_t *hist : histogram of the client, uint64_t value : latency in microseconds
+ * @return		:  NULL
+ *
+ */
+static void hist_record(histogram_t *hist, uint64_t value)
+{
+	hist->counts[hist_index(value)]++;
+	if (hist->total == 0 || value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+	hist->total++;
+}
+
+/*
+ * @function	:  Add the samples of one histogram to another
+ *
+ * @param		:  histogram_t *into : merged histogram, const histogram_t *from : histogram of a client
+ * @return		:  NULL
+ *
+ */
+static void hist_merge(histogram_t *into, const histogram_t *from)
+{
+	if (from->total == 0)
+		return;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+		into->counts[i] += from->counts[i];
+	if (into->total == 0 || from->min < into->min)
+		into->min = from->min;
+	if (from->max > into->max)
+		into->max = from->max;
+	into->total += from->total;
+}
+
+/*
+ * @function	:  Value below which the given fraction of the samples fall
+ *
+ * @param		:  const histogram_t *hist : merged histogram, double fraction : 0.5 for p50
+ * @return		:  latency in microseconds
+ *
+ */
+static uint64_t hist_percentile(const histogram_t *hist, double fraction)
+{
+	uint64_t wanted = (uint64_t)(fraction * hist->total + 0.5);
+	uint64_t seen = 0;
+
+	if (wanted == 0)
+		wanted = 1;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += hist->counts[i];
+		if (seen >= wanted)
+			return (hist_value(i) > hist->max) ? hist->max : hist_value(i);
+	}
+	return hist->max;
+}
+
+/*
+ * @function	:  Open a connection to the server
+ *
+ * @param		:  NULL
+ * @return		:  connected socket, -1 on error
+ *
+ */
+static int connect_server(void)
+{
+	int fd = socket(server_addr->ai_family, SOCK_STREAM, 0);
+	if (fd == -1)
+		return -1;
+	if (connect(fd, server_addr->ai_addr, server_addr->ai_addrlen) == -1)
+	{
+		close(fd);
+		return -1;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &(int){1}, sizeof(int));
+	return fd;
+}
+
+/*
+ * @function	:  Send the whole packet
+ *
+ * @param		:  int fd : connected socket, const char *packet, size_t len
+ * @return		:  0 on success, -1 on error
+ *
+ */
+static int send_all(int fd, const char *packet, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t ret = send(fd, packet, len, MSG_NOSIGNAL);
+		if (ret == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		packet += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/*
+ * @function	:  Receive until the reply holds our packet. Only the last len - 1 bytes of
+ * 				   earlier data are kept, so long histories are scanned once
+ *
+ * @param		:  client_t *client, int fd : connected socket, char *window : 2 * RECV_SIZE scratch,
+ * 				   size_t *window_len : bytes carried over between calls, const char *packet, size_t len
+ * @return		:  0 when the packet was seen, -1 on error or early close
+ *
+ */
+static int recv_until_packet(client_t *client, int fd, char *window, size_t *window_len,
+							 const char *packet, size_t len)
+{
+	while (1)
+	{
+		char *found = memmem(window, *window_len, packet, len);
+		if (found != NULL)
+		{
+			// keep what follows, it belongs to the rest of this reply
+			*window_len -= found + len - window;
+			memmove(window, found + len, *window_len);
+			return 0;
+		}
+		if (*window_len >= len)
+		{
+			memmove(window, window + *window_len - (len - 1), len - 1);
+			*window_len = len - 1;
+		}
+		ssize_t ret = recv(fd, window + *window_len, RECV_SIZE, 0);
+		if (ret <= 0)
+		{
+			if (ret == -1 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		client->bytes_received += ret;
+		*window_len += ret;
+	}
+}
+
+/*
+ * @function	:  Receive until the server closes the connection
+ *
+ * @param		:  client_t *client, int fd : connected socket, char *buff : RECV_SIZE scratch
+ * @return		:  0 on success, -1 on error
+ *
+ */
+static int recv_until_close(client_t *client, int fd, char *buff)
+{
+	while (1)
+	{
+		ssize_t ret = recv(fd, buff, RECV_SIZE, 0);
+		if (ret == 0)
+			return 0;
+		if (ret == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		client->bytes_received += ret;
+	}
+}
+
+/*
+ * @function	:  Client thread, sends its packets and records the latency of every reply.
+ * 				   With a rate the latency is measured from the scheduled send time so a slow
+ * 				   server is not hidden by delayed sends
+ *
+ * @param		:  void *thread_parameter : client_t of this client
+ * @return		:  NULL
+ *
+ */
+static void *client_thread(void *thread_parameter)
+{
+	client_t *client = thread_parameter;
+	char *packet = malloc(packet_size);
+	char *window = malloc(2 * RECV_SIZE);
+	size_t window_len = 0;
+	int fd = -1;
+	uint64_t start = now_ns();
+
+	if (packet == NULL || window == NULL)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	for (long seq = 0; seq < packets; seq++)
+	{
+		// unique packet so the reply can be matched in keep-alive mode
+		int head = snprintf(packet, packet_size, "c%d-s%ld-", client->id, seq);
+		if ((size_t)head >= packet_size)
+			head = packet_size - 1;
+		memset(packet + head, 'x', packet_size - 1 - head);
+		packet[packet_size - 1] = '\n';
+
+		uint64_t scheduled = now_ns();
+		if (rate > 0)
+		{
+			scheduled = start + (uint64_t)(seq * 1e9 / rate);
+			uint64_t now = now_ns();
+			if (scheduled > now)
+			{
+				struct timespec delay = {.tv_sec = (scheduled - now) / 1000000000ULL,
+										 .tv_nsec = (scheduled - now) % 1000000000ULL};
+				nanosleep(&delay, NULL);
+			}
+		}
+
+		if (fd == -1)
+		{
+			fd = connect_server();
+			window_len = 0;
+			if (fd == -1)
+			{
+				client->errors++;
+				continue;
+			}
+		}
+		int ret = send_all(fd, packet, packet_size);
+		if (ret == 0)
+		{
+			if (keepalive)
+				ret = recv_until_packet(client, fd, window, &window_len, packet, packet_size);
+			else
+				ret = recv_until_close(client, fd, window);
+		}
+		if (ret == -1)
+		{
+			client->errors++;
+			close(fd);
+			fd = -1;
+			continue;
+		}
+		client->bytes_sent += packet_size;
+		hist_record(&client->hist, (now_ns() - scheduled) / 1000);
+
+		if (!keepalive)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	if (fd != -1)
+		close(fd);
+	free(packet);
+	free(window);
+	return NULL;
+}
+
+/*
+ * @function	:  Print the summary and a histogram with one row per power of two
+ *
+ * @param		:  const histogram_t *hist : merged histogram, double seconds : run time,
+ * 				   uint64_t sent, uint64_t received : bytes, uint64_t errors : failed packets
+ * @return		:  NULL
+ *
+ */
+static void report(const histogram_t *hist, double seconds, uint64_t sent, uint64_t received, uint64_t errors)
+{
+	uint64_t rows[64] = {0};
+	uint64_t peak = 0;
+	int first = -1, last = -1;
+
+	printf("connections %d, packet %zu bytes, %s, %" PRIu64 " packets in %.3f s, %" PRIu64 " errors\n",
+		   connections, packet_size, keepalive ? "keep-alive" : "connection per packet",
+		   hist->total, seconds, errors);
+	printf("throughput  %.0f packets/s, %.2f MB/s sent, %.2f MB/s received\n",
+		   hist->total / seconds, sent / seconds / 1e6, received / seconds / 1e6);
+	if (hist->total == 0)
+		return;
+	printf("latency us  min %" PRIu64 "  p50 %" PRIu64 "  p90 %" PRIu64 "  p99 %" PRIu64 "  p999 %" PRIu64 "  max %" PRIu64 "\n",
+		   hist->min, hist_percentile(hist, 0.5), hist_percentile(hist, 0.9), hist_percentile(hist, 0.99),
+		   hist_percentile(hist, 0.999), hist->max);
+
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		if (hist->counts[i] == 0)
+			continue;
+		uint64_t value = hist_value(i);
+		int row = (value == 0) ? 0 : 64 - __builtin_clzll(value);
+		rows[row] += hist->counts[i];
+		if (first == -1 || row < first)
+			first = row;
+		if (row > last)
+			last = row;
+	}
+	for (int row = first; row <= last; row++)
+		if (rows[row] > peak)
+			peak = rows[row];
+	for (int row = first; row <= last; row++)
+	{
+		char bar[41];
+		int width = (int)(rows[row] * 40 / peak);
+		memset(bar, '#', width);
+		bar[width] = '\0';
+		printf("%10" PRIu64 " - %10" PRIu64 " us |%-40s| %" PRIu64 "\n",
+			   (row == 0) ? (uint64_t)0 : (uint64_t)1 << (row - 1), ((uint64_t)1 << row) - 1, bar, rows[row]);
+	}
+}
+
+/*
+ * @function	:  Main function, starts the clients and reports the merged results
+ *
+ * @param		:  argc, argv : see usage
+ * @return		:  0 on success
+ *
+ */
+int main(int argc, char *argv[])
+{
+	int opt;
+	histogram_t total = {0};
+	uint64_t sent = 0, received = 0, errors = 0;
+	pthread_attr_t attr;
+
+	while ((opt = getopt(argc, argv, "H:p:c:s:n:r:k")) != -1)
+	{
+		switch (opt)
+		{
+		case 'H':
+			server_host = optarg;
+			break;
+		case 'p':
+			server_port = optarg;
+			break;
+		case 'c':
+			connections = atoi(optarg);
+			break;
+		case 's':
+			packet_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			packets = strtol(optarg, NULL, 10);
+			break;
+		case 'r':
+			rate = strtod(optarg, NULL);
+			break;
+		case 'k':
+			keepalive = true;
+			break;
+		default:
+			printf("Usage: %s [-H host] [-p port] [-c connections] [-s packet size] [-n packets per connection]\n"
+				   "          [-r packets per second per connection] [-k]\n",
+				   argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (connections <= 0 || packets <= 0 || packet_size < 2 || packet_size > RECV_SIZE)
+	{
+		printf("Invalid arguments\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+	int ret = getaddrinfo(server_host, server_port, &hints, &server_addr);
+	if (ret != 0)
+	{
+		printf("getaddrinfo: %s\n", gai_strerror(ret));
+		exit(EXIT_FAILURE);
+	}
+
+	client_t *clients = calloc(connections, sizeof(client_t));
+	if (clients == NULL)
+	{
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+
+	uint64_t begin = now_ns();
+	for (int i = 0; i < connections; i++)
+	{
+		clients[i].id = i;
+		if (pthread_create(&clients[i].thread_id, &attr, client_thread, &clients[i]) != 0)
+		{
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int i = 0; i < connections; i++)
+	{
+		pthread_join(clients[i].thread_id, NULL);
+		hist_merge(&total, &clients[i].hist);
+		sent += clients[i].bytes_sent;
+		received += clients[i].bytes_received;
+		errors += clients[i].errors;
+	}
+	double seconds = (now_ns() - begin) / 1e9;
+
+	report(&total, seconds, sent, received, errors);
+
+	pthread_attr_destroy(&attr);
+	freeaddrinfo(server_addr);
+	free(clients);
+	return (errors == 0) ? 0 : 1;
+}
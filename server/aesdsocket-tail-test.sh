@@ -0,0 +1,48 @@
+#!/bin/bash
+# Tail mode test of a running aesdsocket started with "-t -k <seconds>".
+# One connection writes more packets than the device holds entries, so the
+# oldest ones are evicted while the connection is open, and every reply must
+# carry exactly the packet written just before it. The first reply of the
+# connection carries the whole history held before it.
+# Usage: aesdsocket-tail-test.sh [host] [port] [packets]
+
+host=${1:-localhost}
+port=${2:-9000}
+# more than the default aesdchar capacity of 10 entries
+packets=${3:-25}
+
+exec 3<>/dev/tcp/${host}/${port}
+if [ $? -ne 0 ]; then
+	echo "Could not connect to ${host}:${port}"
+	exit 1
+fi
+
+rc=0
+for i in $(seq 1 ${packets}); do
+	expected="tail packet ${i} of ${packets}"
+	printf '%s\n' "${expected}" >&3
+	if ! read -r -t 5 reply <&3; then
+		echo "No reply to packet ${i}"
+		rc=1
+		break
+	fi
+	# skip the history written before this connection
+	while [ ${i} -eq 1 ] && [ "${reply}" != "${expected}" ]; do
+		if ! read -r -t 5 reply <&3; then
+			echo "No reply to packet ${i}"
+			rc=1
+			break 2
+		fi
+	done
+	if [ "${reply}" != "${expected}" ]; then
+		echo "Packet ${i}: expected \"${expected}\" but received \"${reply}\""
+		rc=1
+		break
+	fi
+done
+exec 3>&-
+
+if [ ${rc} -eq 0 ]; then
+	echo "Tail test of ${packets} packets passed"
+fi
+exit ${rc}
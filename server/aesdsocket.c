@@ -9,6 +9,7 @@
  * 				  https://www.geeksforgeeks.org/socket-programming-cc/
  **************************************************************************************************************************/
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,13 +25,44 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <endian.h>
 #include "queue.h"
+#include "aesd-reply.h"
+#include "aesd-metrics.h"
+#include "aesd-uring.h"
+#include "aesd-cache.h"
+#include "aesd-proto.h"
+#include "aesd-log.h"
 #include "./../aesd-char-driver/aesd_ioctl.h"
 
 #define MAX_BACKLOG (10)
 #define BUFFER_SIZE (1024)
-// Modifications for Assignment8
+#define EPOLL_MAX_EVENTS (64)
+#define POOL_QUEUE_DEPTH (64)
+#define URING_ENTRIES (256)			 // submission ring size of each io_uring reactor
+#define URING_MAX_LINK (16)			 // packets appended by one chain of linked writes
+#define URING_TX_SIZE (64 * 1024)	 // reply bytes read from file_path per read and send round trip
+#define CACHE_LINE_SIZE (64)
+#define WRITER_MAX_IOV (64)			 // packets per group commit
+#define WRITER_MAX_BATCH (64 * 1024) // bytes per group commit
+#define LOG_SEGMENT_SIZE (4UL << 20) // the mapped log file grows by fallocate in these steps
+#define LOG_MAX_SIZE (1UL << 30)	 // address space reserved for the mapped log
+#define STREAM_POS_UNKNOWN (UINT64_MAX) // end of a reply read from data_fd, known once it is sent
+#define HISTORY_MAP_RETRIES (8)			// attempts at a device offset that no eviction shifted meanwhile
+// Modifications for Assignment8, build with USE_AESD_CHAR_DEVICE=0 for the /var/tmp file backend
+#ifndef USE_AESD_CHAR_DEVICE
 #define USE_AESD_CHAR_DEVICE 1
+#endif
+#if !USE_AESD_CHAR_DEVICE
+#undef USE_AESD_CHAR_DEVICE
+#endif
 
 #ifdef USE_AESD_CHAR_DEVICE
 char *file_path = "/dev/aesdchar"; // file to save input string
@@ -48,11 +80,48 @@ int file_fd = 0;			// file as defined in path to be created
 bool process_flag = false;
 int deamon_flag = 0;
 
+// Connection handling models selectable with -m
+typedef enum
+{
+	SERVER_MODE_THREAD = 0, // one pthread per accepted client (default)
+	SERVER_MODE_EPOLL,		// edge-triggered epoll reactors on a fixed set of threads
+	SERVER_MODE_POOL,		// pre-spawned workers fed through a bounded queue of accepted fds
+	SERVER_MODE_URING,		// io_uring reactors, falls back to epoll when the kernel lacks io_uring
+	SERVER_MODE_SHARD,		// epoll reactors pinned to a core, each accepting on its own SO_REUSEPORT listener
+} server_mode_t;
+
+server_mode_t server_mode = SERVER_MODE_THREAD;
+long worker_count = 0;				 // number of reactor/worker threads, 0 means one per online CPU
+long queue_depth = POOL_QUEUE_DEPTH; // accepted connections waiting for a pool worker
+long keepalive_timeout = 0;			 // idle seconds before a persistent connection is closed, 0 closes after one reply
+bool tail_mode = false;				 // replies only carry the bytes appended since the connection's previous reply
+char *metrics_path = NULL;			 // Unix-domain socket serving the runtime metrics, NULL disables it
+
 //  Function prototypes
 void socket_connect(void);
 void *thread_handler(void *thread_parameter);
+void serve_client(int client_fd);
+int process_packet(int data_fd, const char *packet, size_t packet_len, uint64_t reply_from);
+void epoll_server(void);
+void pool_server(void);
+void uring_server(void);
+void shard_server(void);
 #ifndef USE_AESD_CHAR_DEVICE
 pthread_t timer_thread = (pthread_t)NULL;
+pthread_t writer_thread = (pthread_t)NULL;
+bool log_mode = false; // packets go to a memory-mapped append log instead of the writer thread
+void writer_submit(const char *packet, size_t packet_len);
+void store_packet(const char *packet, size_t packet_len);
+int data_log_open(void);
+void data_log_close(void);
+#else
+const struct aesd_mmap_header *history_map = NULL; // read-only mapping of the device history, NULL when not supported
+// Copy of the mapped ring shared by every reply, extended by the bytes written since. Bytes below its
+// len never change, replies hold references to it, data[0] is at stream position history_copy_base
+static pthread_mutex_t history_copy_lock = PTHREAD_MUTEX_INITIALIZER;
+static cache_snapshot_t history_copy;
+static uint64_t history_copy_base;
+int history_map_open(void);
 #endif
 void exit_func(void);
 //  Thread parameter structure
@@ -64,6 +133,34 @@ typedef struct
 
 } thread_ipc;
 
+// Protocol of a connection, told apart by its first bytes
+typedef enum
+{
+	FRAMER_DETECT = 0, // fewer bytes than PROTO_MAGIC received, all of them matching it
+	FRAMER_TEXT,	   // newline terminated packets
+	FRAMER_BINARY,	   // length-prefixed frames, see aesd-proto.h
+	FRAMER_INVALID,	   // a frame announced more than PROTO_MAX_PAYLOAD, the connection is closed
+} framer_protocol_t;
+
+// Incremental newline framer: received bytes are appended to a growable arena and
+// every byte is searched for '\n' only once, however the packets are split across recvs.
+// Binary frames are cut at their announced length without looking at the payload
+typedef struct
+{
+	char *buff;		// arena holding the received bytes
+	size_t len;		// number of bytes received into buff
+	size_t size;	// allocated size of buff, doubled when full
+	size_t scanned; // bytes of buff already searched for '\n'
+	size_t start;	// start of the first packet not handed out yet
+	framer_protocol_t protocol;
+	proto_header_t header; // header of the last frame handed out in binary mode
+} packet_framer_t;
+
+char *framer_space(packet_framer_t *framer, size_t min_space);
+size_t framer_want(packet_framer_t *framer);
+char *framer_next(packet_framer_t *framer, size_t *packet_len);
+char *framer_rest(packet_framer_t *framer, size_t *packet_len);
+
 // Linked list node
 struct slist_data_s
 {
@@ -92,13 +189,25 @@ void signal_handler(int signal_no)
 
 	if (signal_no == SIGINT || signal_no == SIGTERM || signal_no == SIGKILL)
 	{
-		printf("signal detected to exit\n");
-		syslog(LOG_DEBUG, "Caught the signal, exiting...");
-		shutdown(socket_fd, SHUT_RDWR);
+		// only async-signal-safe calls from here on, stdio and syslog may hold locks of the interrupted thread
+		static const char exit_message[] = "signal detected to exit\n";
+		if (write(STDOUT_FILENO, exit_message, sizeof(exit_message) - 1) == -1)
+		{
+			// nowhere left to report the failure
+		}
+		// reactors woken by the shutdown must see the flag while the handler waits for the logger
 		process_flag = true;
+		shutdown(socket_fd, SHUT_RDWR);
 		// unlink(file_path);
 		close(accept_fd);
 		close(socket_fd);
+		if (metrics_path != NULL)
+			unlink(metrics_path);
+#ifndef USE_AESD_CHAR_DEVICE
+		data_log_close();
+#endif
+		// the flusher thread writes the queued messages and the exit message to syslog
+		logger_flush_request("Caught the signal, exiting...");
 	}
 	_exit(0);
 }
@@ -140,444 +249,3258 @@ static void *timer_handler(void *signalno)
 			exit(EXIT_FAILURE);
 		}
 
-		printf("timestamp:%s\n", time_stamp);
-
-		// writing to file
-
-		file_fd = open(file_path, O_APPEND | O_WRONLY);
-		if (file_fd == -1)
-		{
-			printf("Error opening\n");
-			exit(EXIT_FAILURE);
-		}
-
-		int ret = pthread_mutex_lock(&mutex_lock);
-		if (ret)
-		{
-			printf("Mutex lock error before write\n");
-			exit(EXIT_FAILURE);
-		}
+		AESD_LOG(LOG_DEBUG, "%s", time_stamp);
 
-		int write_ret = write(file_fd, time_stamp, timer_len);
-		ret = pthread_mutex_unlock(&mutex_lock);
-		if (ret)
-		{
-			printf("Mutex unlock error after write\n");
-			exit(EXIT_FAILURE);
-		}
-		if (write_ret == -1)
-		{
-			printf("Error write\n");
-			exit(EXIT_FAILURE);
-		}
+		// writing to file, ordered with the client packets
+		store_packet(time_stamp, timer_len);
 		/*update the global packet size variable*/
 		data_count += timer_len;
-
-		close(file_fd);
 	}
 	pthread_exit(NULL);
 }
 #endif
+/*GROUP COMMIT WRITER*/
+struct write_completion_s;
+
+// A packet waiting for the writer thread, lives on the stack of a blocking submitter or in a reactor connection
+typedef struct write_request_s
+{
+	const char *packet;
+	size_t packet_len;
+	bool done;								// set by the writer once the packet is in the file
+	struct write_completion_s *completion; // handed back through it, NULL when the submitter waits on write_flushed
+	void *owner;							// reactor connection resumed once the packet is written
+	STAILQ_ENTRY(write_request_s) entries;
+} write_request_t;
+
+STAILQ_HEAD(write_request_list, write_request_s);
+
+// Written requests of one reactor's connections, the reactor waits for event_fd next to its sockets
+typedef struct write_completion_s
+{
+	int event_fd;					 // readable while done is not empty
+	struct write_request_list done; // protected by mutex_lock
+} write_completion_t;
+
 /*
- * @function	: main fucntion for Socket based communication
+ * @function	:  Set up the completion of a reactor
  *
- * @param		: argc -refers to the number of arguments passed, and argv[] is a pointer array which points to each argument passed
- * @return		: return 0 on success
+ * @param		:  write_completion_t *completion : completion to set up
+ * @return		:  0 on success, -1 when no eventfd could be created
  *
  */
-int main(int argc, char *argv[])
+static int write_completion_init(write_completion_t *completion)
 {
-
-	// open the log file
-	openlog("A6P1", LOG_PID, LOG_USER);
-
-	syslog(LOG_DEBUG, "syslog opened."); // indicating logging
-	// to associate signal handler with corresponding signals using signal() API
-	signal(SIGINT, signal_handler);
-	signal(SIGTERM, signal_handler);
-	signal(SIGKILL, signal_handler);
-
-	pthread_mutex_init(&mutex_lock, NULL);
-
-	// Check the actual value of argv here:
-	if ((argc > 1) && (!strcmp("-d", (char *)argv[1])))
-	{
-
-		printf("Running in daemon mode!\n");
-		syslog(LOG_DEBUG, "aesdsocket entering daemon mode");
-
-		deamon_flag = 1;
-	}
-
-	socket_connect();
-
-	// closing syslog
-	closelog();
-
-	return 0;
+	STAILQ_INIT(&completion->done);
+	// blocking, io_uring waits for it like for a socket
+	completion->event_fd = eventfd(0, EFD_CLOEXEC);
+	return (completion->event_fd == -1) ? -1 : 0;
 }
 
-/*SOCKET COMMUNICATION FUNCTION*/
 /*
- * @function	:  To handle socket communication
+ * @function	:  Take the written requests of a reactor, called once event_fd was read
  *
- * @param		:   struct addrinfo *res holds the local address for binding,
- * 					int socket_fd- socket file descriptor and int accept_fd -file descriptor of client
+ * @param		:  write_completion_t *completion : completion of the calling reactor,
+ * 				   struct write_request_list *done : receives the requests in the order they were written
  * @return		:  NULL
  *
  */
-void socket_connect()
+static void write_completion_collect(write_completion_t *completion, struct write_request_list *done)
 {
+	STAILQ_INIT(done);
+	pthread_mutex_lock(&mutex_lock);
+	STAILQ_CONCAT(done, &completion->done);
+	pthread_mutex_unlock(&mutex_lock);
+}
 
-	// setting the initial paramters
-	struct addrinfo hints;		// for getaddrinfo parameters
-	struct addrinfo *res;		// to get the address
-	struct sockaddr client_add; // to get client address
-	socklen_t client_size;		// size of sockaddr
-	// new variables for A6-P1
-	SLIST_INIT(&head);
-
-	// 1. Set the sockaddr using getaddrinfo
-
-	// clear the hints first
-	memset(&hints, 0, sizeof(hints));
-
-	// set all the hint parameters then
-	hints.ai_flags = AI_PASSIVE;
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
+#ifndef USE_AESD_CHAR_DEVICE
+// Packets not picked up by the writer yet, protected by mutex_lock
+struct write_request_list write_queue = STAILQ_HEAD_INITIALIZER(write_queue);
+pthread_cond_t write_queued = PTHREAD_COND_INITIALIZER;	 // writer waits for packets
+pthread_cond_t write_flushed = PTHREAD_COND_INITIALIZER; // submitters wait for their batch
 
-	// store the result
-	int getret = getaddrinfo(NULL, server_port, &hints, &res);
-	if (getret != 0)
-	{
-		printf("Error while allocating address for socket\n");
-		syslog(LOG_ERR, "Error while setting socket address= %s. Exiting.", strerror(errno));
-		exit(EXIT_FAILURE);
-	}
+/*
+ * @function	:  Append a packet to the data file through the writer thread and wait until it is written.
+ * 				   The packet is written in one piece and in submission order
+ *
+ * @param		:  const char *packet : data to append, size_t packet_len : its size
+ * @return		:  NULL
+ *
+ */
+void writer_submit(const char *packet, size_t packet_len)
+{
+	write_request_t request = {.packet = packet, .packet_len = packet_len, .done = false, .completion = NULL};
 
-	// Step-2 Opening socket
-	printf("Opening socket\n");
-	socket_fd = socket(PF_INET, SOCK_STREAM, 0); // IP family with type SOCK_STREAM and 0 protocol
-	if (socket_fd == -1)						 // generating error
+	int ret = pthread_mutex_lock(&mutex_lock);
+	if (ret)
 	{
-		printf("Error: Socket file descriptor not created\n");
-		syslog(LOG_ERR, "Error while setting socket= %s. Exiting.", strerror(errno));
-		freeaddrinfo(res);
+		printf("Mutex lock error before write\n");
 		exit(EXIT_FAILURE);
 	}
-
-	int socket_ret = setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int));
-	if (socket_ret < 0)
-	{
-		printf("Error: setsockopt failed\n");
-		syslog(LOG_ERR, "Error: setsockopt failed");
-		printf("setsockopt error: %s\n", strerror(errno));
-		freeaddrinfo(res);
-		exit(1);
-	}
-
-	// Step-3 Binding to address
-	printf("Binding socket descriptor to address\n");
-	int temp2 = bind(socket_fd, res->ai_addr, res->ai_addrlen);
-	if (temp2 == -1) // generating error
+	STAILQ_INSERT_TAIL(&write_queue, &request, entries);
+	pthread_cond_signal(&write_queued);
+	while (request.done == false)
 	{
-		printf("Error: Binding with address failed\n");
-		syslog(LOG_ERR, "Error while binding socket= %s. Exiting.", strerror(errno));
-		freeaddrinfo(res);
-		exit(EXIT_FAILURE);
+		pthread_cond_wait(&write_flushed, &mutex_lock);
 	}
-
-	// Create file
-	file_fd = creat(file_path, 0644);
-	if (file_fd == -1)
+	ret = pthread_mutex_unlock(&mutex_lock);
+	if (ret)
 	{
-		printf("Error while creating file \n");
-		syslog(LOG_ERR, "Error: File could not be created!= %s. Exiting...", strerror(errno));
+		printf("Mutex unlock error after write\n");
 		exit(EXIT_FAILURE);
 	}
+}
 
-	// close fd after creating
-	close(file_fd);
+/*
+ * @function	:  Queue a packet for the writer thread without waiting, used by the reactors. The request
+ * 				   and the packet must stay untouched until the request comes back through the completion
+ *
+ * @param		:  write_request_t *request : request of the connection, const char *packet : data to append,
+ * 				   size_t packet_len : its size, write_completion_t *completion : completion of the calling reactor,
+ * 				   void *owner : connection to resume
+ * @return		:  NULL
+ *
+ */
+static void writer_submit_async(write_request_t *request, const char *packet, size_t packet_len,
+								write_completion_t *completion, void *owner)
+{
+	request->packet = packet;
+	request->packet_len = packet_len;
+	request->done = false;
+	request->completion = completion;
+	request->owner = owner;
+	pthread_mutex_lock(&mutex_lock);
+	STAILQ_INSERT_TAIL(&write_queue, request, entries);
+	pthread_cond_signal(&write_queued);
+	pthread_mutex_unlock(&mutex_lock);
+}
 
-	// free after use
-	freeaddrinfo(res);
+/*
+ * @function	:  Writer thread, takes every queued packet (up to WRITER_MAX_IOV packets or
+ * 				   WRITER_MAX_BATCH bytes) and appends them with a single writev. Packets queued
+ * 				   while a batch is written form the next batch, so a packet waits for at most
+ * 				   one batch ahead of it
+ *
+ * @param		:  void *thread_parameter : unused
+ * @return		:  NULL
+ *
+ */
+static void *writer_handler(void *thread_parameter)
+{
+	struct iovec iov[WRITER_MAX_IOV];
+	struct write_request_list batch;
 
-	if (deamon_flag == 1)
+	int writer_fd = open(file_path, O_CREAT | O_APPEND | O_WRONLY, 0644);
+	if (writer_fd == -1)
 	{
-		int temp_daemon = daemon(0, 0);
-		if (temp_daemon == -1)
-		{
-			printf("Couldn't process into deamon mode\n");
-			syslog(LOG_ERR, "failed to enter deamon mode %s", strerror(errno));
-		}
+		printf("Error opening\n");
+		exit(EXIT_FAILURE);
 	}
-#ifndef USE_AESD_CHAR_DEVICE
-	bool timer_thread_flag = false;
-#endif
+
 	while (process_flag == false)
 	{
-#ifndef USE_AESD_CHAR_DEVICE
-		if (!timer_thread_flag)
+		int iov_count = 0;
+		size_t batch_len = 0;
+
+		pthread_mutex_lock(&mutex_lock);
+		while (STAILQ_EMPTY(&write_queue))
 		{
-			pthread_create(&timer_thread, NULL, timer_handler, NULL);
-			timer_thread_flag = true;
+			pthread_cond_wait(&write_queued, &mutex_lock);
 		}
-#endif
-		// step-4 Listening for client
-		int temp_listen = listen(socket_fd, MAX_BACKLOG);
-		if (temp_listen == -1) // generating error
+		// take the head of the queue as one batch, an oversized packet still goes alone
+		STAILQ_INIT(&batch);
+		while (!STAILQ_EMPTY(&write_queue) && iov_count < WRITER_MAX_IOV &&
+			   (iov_count == 0 || batch_len + STAILQ_FIRST(&write_queue)->packet_len <= WRITER_MAX_BATCH))
 		{
-			printf("Error while listening \n");
-			syslog(LOG_ERR, "Error: Listening failed =%s. Exiting ", strerror(errno));
-			freeaddrinfo(res);
-			exit(EXIT_FAILURE);
+			write_request_t *request = STAILQ_FIRST(&write_queue);
+			STAILQ_REMOVE_HEAD(&write_queue, entries);
+			STAILQ_INSERT_TAIL(&batch, request, entries);
+			iov[iov_count].iov_base = (void *)request->packet;
+			iov[iov_count].iov_len = request->packet_len;
+			batch_len += request->packet_len;
+			iov_count++;
 		}
+		pthread_mutex_unlock(&mutex_lock);
 
-		client_size = sizeof(struct sockaddr);
-
-		// step -5 Accepting connection
-		accept_fd = accept(socket_fd, (struct sockaddr *)&client_add, &client_size);
-		if (accept_fd == -1) // generating error
+		// one O_APPEND writev for the whole batch, resumed if the kernel takes only part of it
+		struct iovec *pending = iov;
+		while (iov_count > 0)
 		{
-			printf("Error while accepting \n");
-			syslog(LOG_ERR, "Error: Accepting failed =%s. Exiting ", strerror(errno));
-			exit(EXIT_FAILURE);
+			ssize_t write_ret = writev(writer_fd, pending, iov_count);
+			if (write_ret == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				printf("Error write\n");
+				exit(EXIT_FAILURE);
+			}
+			while (iov_count > 0 && (size_t)write_ret >= pending->iov_len)
+			{
+				write_ret -= pending->iov_len;
+				pending++;
+				iov_count--;
+			}
+			if (iov_count > 0)
+			{
+				pending->iov_base = (char *)pending->iov_base + write_ret;
+				pending->iov_len -= write_ret;
+			}
 		}
-		// to get the client address in a readable format
-		struct sockaddr_in *addr_in = (struct sockaddr_in *)&client_add;
-		char *addr_ip = inet_ntoa(addr_in->sin_addr); // using inet_ntoa function
-
-		syslog(LOG_DEBUG, "Connection succesful. Accepting connection from %s", addr_ip);
-		printf("Connection succesful.Accepting connection from %s\n", addr_ip);
-
-		/*Adding below part for A6-P1*/
-
-		// allocating new node for the data
-		datap = (slist_data_t *)malloc(sizeof(slist_data_t));
-
-		SLIST_INSERT_HEAD(&head, datap, entries);
-
-		// Inserting thread parameters now
-		datap->thread_socket.client_fd = accept_fd;
-		datap->thread_socket.thread_complete = false;
-
-		pthread_create(&(datap->thread_socket.thread_id), // the thread id to be created
-					   NULL,							  // the thread attribute to be passed
-					   thread_handler,					  // the thread handler to be executed
-					   &datap->thread_socket			  // the thread parameter to be passed
-		);
-
-		printf("Threads created now waiting to exit\n");
 
-		SLIST_FOREACH(datap, &head, entries)
+		// the partial write handling moved iov, describe the batch again for the cache
+		write_request_t *request;
+		STAILQ_FOREACH(request, &batch, entries)
 		{
+			iov[iov_count].iov_base = (void *)request->packet;
+			iov[iov_count].iov_len = request->packet_len;
+			iov_count++;
+		}
+		cache_append(iov, iov_count);
 
-			if (datap->thread_socket.thread_complete == true)
+		pthread_mutex_lock(&mutex_lock);
+		while ((request = STAILQ_FIRST(&batch)) != NULL)
+		{
+			STAILQ_REMOVE_HEAD(&batch, entries);
+			request->done = true;
+			if (request->completion == NULL)
+				continue;
+			// the reactor takes the whole list per wakeup, only the first request needs to wake it
+			if (STAILQ_EMPTY(&request->completion->done))
 			{
-				pthread_join(datap->thread_socket.thread_id, NULL);
-				SLIST_REMOVE(&head, datap, slist_data_s, entries);
-				free(datap);
-				break;
+				uint64_t one = 1;
+				if (write(request->completion->event_fd, &one, sizeof(one)) == -1)
+					AESD_LOG(LOG_ERR, "Error: eventfd write failed =%s", strerror(errno));
 			}
+			STAILQ_INSERT_TAIL(&request->completion->done, request, entries);
 		}
+		pthread_cond_broadcast(&write_flushed);
+		pthread_mutex_unlock(&mutex_lock);
+	}
+	close(writer_fd);
+	return NULL;
+}
 
-		printf("All thread exited!\n");
+/*MAPPED APPEND LOG*/
+// The data file mapped once into a contiguous LOG_MAX_SIZE window and preallocated
+// in LOG_SEGMENT_SIZE steps. Writers reserve their range with an atomic fetch-add and
+// copy in parallel, readers send the committed prefix straight from the mapping
+typedef struct
+{
+	int fd;
+	char *base;				   // start of the mapping
+	pthread_mutex_t grow_lock; // serializes fallocate of new segments
+	// each counter on its own cache line, writers hammer reserved and committed
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t reserved;  // end of the last reserved range
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t allocated; // bytes preallocated in the file
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t committed; // every byte below is written, in order
+} data_log_t;
 
-		syslog(LOG_DEBUG, "Closed connection from %s", addr_ip);
-		printf("Closed connection from %s\n", addr_ip);
-	}
+data_log_t data_log = {.fd = -1, .grow_lock = PTHREAD_MUTEX_INITIALIZER};
 
-	// 9. Close sfd, accept_fd
-	close(accept_fd);
-	close(socket_fd);
+/*
+ * @function	:  Truncate the data file to a fresh first segment and map the log window
+ *
+ * @param		:  NULL
+ * @return		:  0 on success, -1 on error
+ *
+ */
+int data_log_open(void)
+{
+	data_log.fd = open(file_path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (data_log.fd == -1)
+		return -1;
+	if (fallocate(data_log.fd, 0, 0, LOG_SEGMENT_SIZE) == -1)
+		return -1;
+	// pages past the end of file are only touched after a later fallocate extended it
+	data_log.base = mmap(NULL, LOG_MAX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, data_log.fd, 0);
+	if (data_log.base == MAP_FAILED)
+		return -1;
+	atomic_init(&data_log.reserved, 0);
+	atomic_init(&data_log.allocated, LOG_SEGMENT_SIZE);
+	atomic_init(&data_log.committed, 0);
+	return 0;
 }
 
-/*THREAD HANDLER*/
 /*
- * @function	:  Thread handler function for receiving and sending data
+ * @function	:  Cut the preallocated tail off the data file, safe to call from the signal handler.
+ * 				   A failure is not reported, syslog is not async-signal-safe
  *
- * @param		:  void *thread_parameters: thread parameters
- * @return		:   void *thread_parameters
+ * @param		:  NULL
+ * @return		:  NULL
  *
  */
-void *thread_handler(void *thread_parameter)
+void data_log_close(void)
 {
+	if (data_log.fd != -1 && ftruncate(data_log.fd, atomic_load(&data_log.committed)) == -1)
+	{
+		// the tail stays preallocated, the next start truncates the file anyway
+	}
+}
 
-	// Package storage related variables
-	bool packet_comp = false;
-	int i, j = 0;
-	int ret_recv = 0;
-	int ret = 0;
-	char buff[BUFFER_SIZE] = {0};
-	char *output_buffer = NULL;
-	// char *send_buffer = NULL;
-
-	// get the parameter of the thread
-	thread_ipc *params = (thread_ipc *)thread_parameter;
+/*
+ * @function	:  Append a packet to the mapped log, concurrent appends only contend on the
+ * 				   reservation counter and on publishing in reservation order
+ *
+ * @param		:  const char *packet : data to append, size_t packet_len : its size
+ * @return		:  NULL
+ *
+ */
+static void data_log_append(const char *packet, size_t packet_len)
+{
+	size_t offset = atomic_fetch_add(&data_log.reserved, packet_len);
+	size_t end = offset + packet_len;
 
-	// For test
-	output_buffer = (char *)malloc(sizeof(char) * BUFFER_SIZE);
-	if (output_buffer == NULL)
+	if (end > LOG_MAX_SIZE)
 	{
-		printf("Malloc failed!\n");
-		exit(1);
+		printf("Error write\n");
+		syslog(LOG_ERR, "Error: mapped log is full. Exiting.");
+		exit(EXIT_FAILURE);
 	}
-	memset(output_buffer, 0, BUFFER_SIZE);
-	// For test
-
-	/*Packet reception, detection and storage logic*/
-	while (packet_comp == false)
+	if (atomic_load(&data_log.allocated) < end)
 	{
-
-		// printf("Receiving data from descriptor:%d.\n",sfd);
-
-		ret_recv = recv(params->client_fd, buff, BUFFER_SIZE, 0); //**!check the flag
+		pthread_mutex_lock(&data_log.grow_lock);
+		size_t allocated = atomic_load(&data_log.allocated);
+		while (allocated < end)
+		{
+			if (fallocate(data_log.fd, 0, allocated, LOG_SEGMENT_SIZE) == -1)
+			{
+				printf("Error write\n");
+				syslog(LOG_ERR, "Error: fallocate failed =%s. Exiting.", strerror(errno));
+				exit(EXIT_FAILURE);
+			}
+			allocated += LOG_SEGMENT_SIZE;
+		}
+		atomic_store(&data_log.allocated, allocated);
+		pthread_mutex_unlock(&data_log.grow_lock);
+	}
+
+	memcpy(data_log.base + offset, packet, packet_len);
+
+	// publish in reservation order so readers never see a hole
+	while (atomic_load_explicit(&data_log.committed, memory_order_acquire) != offset)
+		sched_yield();
+	atomic_store_explicit(&data_log.committed, end, memory_order_release);
+}
+
+/*
+ * @function	:  Append a packet to the data file with the selected file backend
+ *
+ * @param		:  const char *packet : data to append, size_t packet_len : its size
+ * @return		:  NULL
+ *
+ */
+void store_packet(const char *packet, size_t packet_len)
+{
+	if (log_mode)
+		data_log_append(packet, packet_len);
+	else
+		writer_submit(packet, packet_len);
+}
+#endif
+
+#ifdef USE_AESD_CHAR_DEVICE
+/*HISTORY MAPPING*/
+/*
+ * @function	:  Map the history of the char device read-only, see struct aesd_mmap_header
+ *
+ * @param		:  NULL
+ * @return		:  0 on success, -1 when the driver does not support mmap
+ *
+ */
+int history_map_open(void)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	const struct aesd_mmap_header *header;
+	size_t map_len;
+
+	int map_fd = open(file_path, O_RDONLY);
+	if (map_fd == -1)
+		return -1;
+	// the header tells how large the whole mapping is
+	header = mmap(NULL, page_size, PROT_READ, MAP_SHARED, map_fd, 0);
+	if (header == MAP_FAILED)
+	{
+		close(map_fd);
+		return -1;
+	}
+	if (header->magic != AESDCHAR_MMAP_MAGIC)
+	{
+		munmap((void *)header, page_size);
+		close(map_fd);
+		errno = EPROTO;
+		return -1;
+	}
+	map_len = header->header_size + 2 * header->data_size;
+	munmap((void *)header, page_size);
+
+	header = mmap(NULL, map_len, PROT_READ, MAP_SHARED, map_fd, 0);
+	close(map_fd); // the mapping keeps the device open
+	if (header == MAP_FAILED)
+		return -1;
+	history_map = header;
+	return 0;
+}
+
+/*
+ * @function	:  Read the start and end positions of the mapped history consistently
+ *
+ * @param		:  uint64_t *start : position of file offset 0, uint64_t *end : position after the last byte
+ * @return		:  NULL
+ *
+ */
+static void history_map_snapshot(uint64_t *start, uint64_t *end)
+{
+	uint64_t sequence;
+
+	do
+	{
+		// odd while the driver updates the mapping
+		sequence = __atomic_load_n(&history_map->sequence, __ATOMIC_ACQUIRE);
+		*start = history_map->start;
+		*end = history_map->end;
+		atomic_thread_fence(memory_order_acquire);
+	} while ((sequence & 1) || sequence != __atomic_load_n(&history_map->sequence, __ATOMIC_RELAXED));
+}
+
+/*
+ * @function	:  File offset of data_fd together with the mapped history start it counts from. The driver
+ * 				   counts offsets from its oldest entry, so the offset is only taken when no eviction moved
+ * 				   the start while it was read
+ *
+ * @param		:  int data_fd : descriptor of file_path, uint64_t *start : position of file offset 0
+ * @return		:  the file offset, -1 when lseek failed or evictions kept moving the start
+ *
+ */
+static off_t history_map_offset(int data_fd, uint64_t *start)
+{
+	uint64_t end;
+	uint64_t after;
+
+	for (int attempt = 0; attempt < HISTORY_MAP_RETRIES; attempt++)
+	{
+		history_map_snapshot(start, &end);
+		off_t offset = lseek(data_fd, 0, SEEK_CUR);
+		history_map_snapshot(&after, &end);
+		if (offset == -1 || after == *start)
+			return offset;
+	}
+	return -1;
+}
+
+/*
+ * @function	:  Move data_fd to a stream position, retried when an eviction moved the start the offset was
+ * 				   computed from before lseek took it. A position before the oldest entry held moves to it
+ *
+ * @param		:  int data_fd : descriptor of file_path, uint64_t pos : stream position, at most the end
+ * @return		:  0 on success, -1 when lseek failed or evictions kept moving the start
+ *
+ */
+static int history_map_seek(int data_fd, uint64_t pos)
+{
+	uint64_t start;
+	uint64_t end;
+	uint64_t after;
+
+	for (int attempt = 0; attempt < HISTORY_MAP_RETRIES; attempt++)
+	{
+		history_map_snapshot(&start, &end);
+		if (pos > end)
+			pos = end;
+		off_t offset = lseek(data_fd, (pos > start) ? pos - start : 0, SEEK_SET);
+		history_map_snapshot(&after, &end);
+		// a position past the entries left after an eviction fails with EINVAL, retried from the new start
+		if (after == start)
+			return (offset == -1) ? -1 : 0;
+	}
+	return -1;
+}
+
+/*
+ * @function	:  Share the copy of the mapped ring, first appending the bytes written since it was last
+ * 				   extended. Every reply sends from this one copy instead of copying the ring for itself,
+ * 				   and the ring is copied once however many connections reply
+ *
+ * @param		:  cache_snapshot_t *snapshot : filled in with a reference to the copy, release with cache_release,
+ * 				   uint64_t *base : stream position of the first byte of snapshot->data
+ * @return		:  true with the copy, false when it could not be brought up to date, replies are read then
+ *
+ */
+static bool history_copy_acquire(cache_snapshot_t *snapshot, uint64_t *base)
+{
+	// the ring is mapped twice in a row, a range crossing its end is still contiguous
+	const char *ring = (const char *)history_map + history_map->header_size;
+	uint64_t ring_size = history_map->data_size;
+	uint64_t start;
+	uint64_t end;
+	bool shared = false;
+
+	pthread_mutex_lock(&history_copy_lock);
+	history_map_snapshot(&start, &end);
+	uint64_t copied = history_copy_base + history_copy.len;
+	if (history_copy.buffer == NULL || copied > end || end - copied > ring_size)
+	{
+		// first copy, or writers wrapped over bytes never copied: start again from what the ring holds
+		cache_release(&history_copy);
+		history_copy_base = copied = (end - start > ring_size) ? end - ring_size : start;
+		history_copy.len = 0;
+	}
+	size_t add = end - copied;
+	if (history_copy.buffer == NULL || history_copy.len + add > history_copy.buffer->size)
+	{
+		// replies keep the full buffer, the new one starts with at most a ring of the copied bytes
+		size_t keep = (history_copy.len + add > ring_size) ? ring_size - add : history_copy.len;
+		cache_snapshot_t grown;
+		char *data = cache_private(&grown, 2 * ring_size);
+
+		if (data == NULL)
+			goto unlock;
+		if (keep > 0)
+			memcpy(data, history_copy.data + history_copy.len - keep, keep);
+		cache_release(&history_copy);
+		history_copy = grown;
+		history_copy.len = keep;
+		history_copy_base = copied - keep;
+	}
+	if (add > 0)
+	{
+		// past len, no reply sees these bytes until they are validated
+		memcpy(history_copy.buffer->data + history_copy.len, ring + (copied & (ring_size - 1)), add);
+		atomic_thread_fence(memory_order_acquire);
+
+		// writers completed meanwhile must not have overwritten the copied positions
+		uint64_t recheck_start;
+		uint64_t recheck_end;
+		history_map_snapshot(&recheck_start, &recheck_end);
+		if (recheck_end - copied > ring_size)
+			goto unlock;
+		history_copy.len += add;
+	}
+	cache_share(&history_copy, snapshot);
+	*base = history_copy_base;
+	shared = true;
+
+unlock:
+	pthread_mutex_unlock(&history_copy_lock);
+	return shared;
+}
+#endif
+
+/*REPLY*/
+/*
+ * @function	:  Stream position of the file position of data_fd. Device offsets count from the oldest entry
+ * 				   held and shift down on every eviction, the mapped history start turns them into positions
+ * 				   counted since the device was loaded. Without the mapping the offset is returned as is
+ *
+ * @param		:  int data_fd : descriptor of file_path
+ * @return		:  the stream position
+ *
+ */
+static uint64_t data_stream_pos(int data_fd)
+{
+#ifdef USE_AESD_CHAR_DEVICE
+	if (history_map != NULL)
+	{
+		uint64_t start;
+		off_t offset = history_map_offset(data_fd, &start);
+		// without a stable offset, the oldest entry held is where a reply starts anyway
+		return start + ((offset == -1) ? 0 : offset);
+	}
+#endif
+	return lseek(data_fd, 0, SEEK_CUR);
+}
+
+/*
+ * @function	:  Move the file position of data_fd to a stream position, see data_stream_pos. Bytes already
+ * 				   evicted are gone, a position before the oldest entry held moves to it
+ *
+ * @param		:  int data_fd : descriptor of file_path, uint64_t pos : stream position
+ * @return		:  NULL
+ *
+ */
+static void data_stream_seek(int data_fd, uint64_t pos)
+{
+#ifdef USE_AESD_CHAR_DEVICE
+	if (history_map != NULL)
+	{
+		if (history_map_seek(data_fd, pos) == -1)
+			AESD_LOG(LOG_ERR, "Error: seeking the history failed =%s", strerror(errno));
+		return;
+	}
+#endif
+	lseek(data_fd, pos, SEEK_SET);
+}
+
+/*
+ * @function	:  Locate the reply from the current position of data_fd in memory, with the mapped log,
+ * 				   the history cache or the mapped device history data_fd then only tracks the position and
+ * 				   is moved to the end. Writers keep overwriting the device ring, so replies from it are
+ * 				   sent from the copy shared by history_copy_acquire
+ *
+ * @param		:  int data_fd : descriptor of file_path, const char **data and size_t *len : the reply,
+ * 				   cache_snapshot_t *snapshot : cache snapshot holding the reply, release with cache_release,
+ * 				   uint64_t *reply_end : stream position following the reply, STREAM_POS_UNKNOWN when read from data_fd
+ * @return		:  true when the reply is in memory, false when it has to be read from data_fd
+ *
+ */
+static bool reply_memory_source(int data_fd, const char **data, size_t *len, cache_snapshot_t *snapshot,
+								uint64_t *reply_end)
+{
+	snapshot->buffer = NULL;
+	*reply_end = STREAM_POS_UNKNOWN;
+#ifdef USE_AESD_CHAR_DEVICE
+	if (history_map != NULL)
+	{
+		uint64_t start;
+		uint64_t base;
+		off_t offset = history_map_offset(data_fd, &start);
+		uint64_t from = start + offset;
+
+		if (offset != -1 && history_copy_acquire(snapshot, &base))
+		{
+			uint64_t end = base + snapshot->len;
+
+			// bytes before the copy were overwritten in the ring, the driver still holds them
+			if (from >= base && from <= end)
+			{
+				if (history_map_seek(data_fd, end) == 0)
+				{
+					*data = snapshot->data + (from - base);
+					*len = end - from;
+					*reply_end = end;
+					return true;
+				}
+				// read from the start of the reply instead
+				history_map_seek(data_fd, from);
+			}
+			cache_release(snapshot);
+		}
+	}
+#endif
+#ifndef USE_AESD_CHAR_DEVICE
+	if (log_mode)
+	{
+		size_t from = lseek(data_fd, 0, SEEK_CUR);
+		size_t end = atomic_load_explicit(&data_log.committed, memory_order_acquire);
+
+		if (from > end)
+			from = end;
+		*data = data_log.base + from;
+		*len = end - from;
+		*reply_end = end;
+		lseek(data_fd, end, SEEK_SET);
+		return true;
+	}
+	// every connection shares the snapshot of the writer's last batch instead of reading the file again
+	if (cache_acquire(snapshot))
+	{
+		size_t from = lseek(data_fd, 0, SEEK_CUR);
+
+		if (from > snapshot->len)
+			from = snapshot->len;
+		*data = snapshot->data + from;
+		*len = snapshot->len - from;
+		*reply_end = snapshot->len;
+		lseek(data_fd, snapshot->len, SEEK_SET);
+		return true;
+	}
+#endif
+	return false;
+}
+
+/*
+ * @function	:  Start a reply from the current position of data_fd, from memory when
+ * 				   reply_memory_source finds it there
+ *
+ * @param		:  reply_state_t *reply : reply to start, int data_fd : descriptor of file_path,
+ * 				   cache_snapshot_t *snapshot : released with cache_release once the reply is finished,
+ * 				   uint64_t *reply_end : stream position following the reply, see reply_memory_source
+ * @return		:  NULL
+ *
+ */
+static void reply_begin(reply_state_t *reply, int data_fd, cache_snapshot_t *snapshot, uint64_t *reply_end)
+{
+	const char *data;
+	size_t len;
+
+	if (reply_memory_source(data_fd, &data, &len, snapshot, reply_end))
+		reply_start_memory(reply, data, len);
+	else
+		reply_start(reply, data_fd, REPLY_AUTO);
+}
+
+/*
+ * @function	:  Stream position following a finished reply, where the next tail reply of the connection starts
+ *
+ * @param		:  int data_fd : descriptor the reply was sent from, uint64_t reply_end : set by reply_memory_source
+ * 				   when the reply began, a reply read from data_fd ends at its file position
+ * @return		:  the stream position
+ *
+ */
+static uint64_t reply_tail_pos(int data_fd, uint64_t reply_end)
+{
+	return (reply_end != STREAM_POS_UNKNOWN) ? reply_end : data_stream_pos(data_fd);
+}
+
+/*
+ * @function	: main fucntion for Socket based communication
+ *
+ * @param		: argc -refers to the number of arguments passed, and argv[] is a pointer array which points to each argument passed
+ * @return		: return 0 on success
+ *
+ */
+int main(int argc, char *argv[])
+{
+
+	// open the log file
+	openlog("A6P1", LOG_PID, LOG_USER);
+
+	syslog(LOG_DEBUG, "syslog opened."); // indicating logging
+	// to associate signal handler with corresponding signals using signal() API
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGKILL, signal_handler);
+	// a client closing early must not kill the server in the middle of a reply
+	signal(SIGPIPE, SIG_IGN);
+
+	pthread_mutex_init(&mutex_lock, NULL);
+
+	// Check the actual value of argv here:
+	int opt = 0;
+	while ((opt = getopt(argc, argv, "dm:w:q:k:tls:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd':
+			printf("Running in daemon mode!\n");
+			syslog(LOG_DEBUG, "aesdsocket entering daemon mode");
+
+			deamon_flag = 1;
+			break;
+		case 'm':
+			if (!strcmp("thread", optarg))
+				server_mode = SERVER_MODE_THREAD;
+			else if (!strcmp("epoll", optarg))
+				server_mode = SERVER_MODE_EPOLL;
+			else if (!strcmp("pool", optarg))
+				server_mode = SERVER_MODE_POOL;
+			else if (!strcmp("uring", optarg))
+				server_mode = SERVER_MODE_URING;
+			else if (!strcmp("shard", optarg))
+				server_mode = SERVER_MODE_SHARD;
+			else
+			{
+				printf("Unknown mode %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'w':
+			worker_count = strtol(optarg, NULL, 10);
+			if (worker_count <= 0)
+			{
+				printf("Invalid worker count %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'q':
+			queue_depth = strtol(optarg, NULL, 10);
+			if (queue_depth <= 0)
+			{
+				printf("Invalid queue depth %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'k':
+			keepalive_timeout = strtol(optarg, NULL, 10);
+			if (keepalive_timeout <= 0)
+			{
+				printf("Invalid idle timeout %s\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 't':
+			tail_mode = true;
+			break;
+		case 'l':
+#ifndef USE_AESD_CHAR_DEVICE
+			log_mode = true;
+#else
+			printf("The mapped log needs the file backend\n");
+			exit(EXIT_FAILURE);
+#endif
+			break;
+		case 's':
+			metrics_path = optarg;
+			break;
+		default:
+			printf("Usage: %s [-d] [-m thread|epoll|pool|uring|shard] [-w workers] [-q queue depth] [-k idle seconds] [-t] [-l] [-s metrics socket]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (worker_count == 0)
+	{
+		worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+		if (worker_count <= 0)
+			worker_count = 1;
+	}
+
+	socket_connect();
+
+	// closing syslog
+	closelog();
+
+	return 0;
+}
+
+/*SOCKET COMMUNICATION FUNCTION*/
+/*
+ * @function	:  To handle socket communication
+ *
+ * @param		:   struct addrinfo *res holds the local address for binding,
+ * 					int socket_fd- socket file descriptor and int accept_fd -file descriptor of client
+ * @return		:  NULL
+ *
+ */
+void socket_connect()
+{
+
+	// setting the initial paramters
+	struct addrinfo hints;		// for getaddrinfo parameters
+	struct addrinfo *res;		// to get the address
+	struct sockaddr client_add; // to get client address
+	socklen_t client_size;		// size of sockaddr
+	// new variables for A6-P1
+	SLIST_INIT(&head);
+
+	// 1. Set the sockaddr using getaddrinfo
+
+	// clear the hints first
+	memset(&hints, 0, sizeof(hints));
+
+	// set all the hint parameters then
+	hints.ai_flags = AI_PASSIVE;
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	// store the result
+	int getret = getaddrinfo(NULL, server_port, &hints, &res);
+	if (getret != 0)
+	{
+		printf("Error while allocating address for socket\n");
+		syslog(LOG_ERR, "Error while setting socket address= %s. Exiting.", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// Step-2 Opening socket
+	printf("Opening socket\n");
+	socket_fd = socket(PF_INET, SOCK_STREAM, 0); // IP family with type SOCK_STREAM and 0 protocol
+	if (socket_fd == -1)						 // generating error
+	{
+		printf("Error: Socket file descriptor not created\n");
+		syslog(LOG_ERR, "Error while setting socket= %s. Exiting.", strerror(errno));
+		freeaddrinfo(res);
+		exit(EXIT_FAILURE);
+	}
+
+	int socket_ret = setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int));
+	if (socket_ret < 0)
+	{
+		printf("Error: setsockopt failed\n");
+		syslog(LOG_ERR, "Error: setsockopt failed");
+		printf("setsockopt error: %s\n", strerror(errno));
+		freeaddrinfo(res);
+		exit(1);
+	}
+	// the shard listeners bind the same port next to this socket
+	if (server_mode == SERVER_MODE_SHARD && setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) < 0)
+	{
+		printf("Error: setsockopt failed\n");
+		syslog(LOG_ERR, "Error: SO_REUSEPORT failed =%s", strerror(errno));
+		freeaddrinfo(res);
+		exit(1);
+	}
+
+	// Step-3 Binding to address
+	printf("Binding socket descriptor to address\n");
+	int temp2 = bind(socket_fd, res->ai_addr, res->ai_addrlen);
+	if (temp2 == -1) // generating error
+	{
+		printf("Error: Binding with address failed\n");
+		syslog(LOG_ERR, "Error while binding socket= %s. Exiting.", strerror(errno));
+		freeaddrinfo(res);
+		exit(EXIT_FAILURE);
+	}
+
+	// Create file
+	file_fd = creat(file_path, 0644);
+	if (file_fd == -1)
+	{
+		printf("Error while creating file \n");
+		syslog(LOG_ERR, "Error: File could not be created!= %s. Exiting...", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// close fd after creating
+	close(file_fd);
+
+	// free after use
+	freeaddrinfo(res);
+
+	if (deamon_flag == 1)
+	{
+		int temp_daemon = daemon(0, 0);
+		if (temp_daemon == -1)
+		{
+			printf("Couldn't process into deamon mode\n");
+			syslog(LOG_ERR, "failed to enter deamon mode %s", strerror(errno));
+		}
+	}
+	// after daemon(), the flusher and metrics threads would not survive the fork
+	if (logger_start(deamon_flag == 0) == -1)
+	{
+		printf("Error while starting the logger \n");
+		syslog(LOG_ERR, "Error: logger thread failed. Exiting...");
+		exit(EXIT_FAILURE);
+	}
+	if (metrics_path != NULL && metrics_start(metrics_path) == -1)
+	{
+		printf("Error while opening the metrics socket \n");
+		syslog(LOG_ERR, "Error: metrics socket %s failed =%s. Exiting...", metrics_path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+#ifndef USE_AESD_CHAR_DEVICE
+	if (log_mode)
+	{
+		if (data_log_open() == -1)
+		{
+			printf("Error while mapping the log \n");
+			syslog(LOG_ERR, "Error: mapping the log failed =%s. Exiting...", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		// creat() emptied the data file, the cache starts empty as well
+		if (cache_init() == -1)
+		{
+			syslog(LOG_ERR, "Error: history cache unavailable, replies are read");
+		}
+		pthread_create(&writer_thread, NULL, writer_handler, NULL);
+	}
+	pthread_create(&timer_thread, NULL, timer_handler, NULL);
+#else
+	// drivers without mmap are still served through read
+	if (history_map_open() == -1)
+	{
+		syslog(LOG_DEBUG, "History mapping unavailable =%s, replies are read", strerror(errno));
+	}
+#endif
+	if (server_mode != SERVER_MODE_THREAD)
+	{
+		if (server_mode == SERVER_MODE_EPOLL)
+			epoll_server();
+		else if (server_mode == SERVER_MODE_URING)
+			uring_server();
+		else if (server_mode == SERVER_MODE_SHARD)
+			shard_server();
+		else
+			pool_server();
+		return;
+	}
+	// step-4 Listening for client
+	int temp_listen = listen(socket_fd, MAX_BACKLOG);
+	if (temp_listen == -1) // generating error
+	{
+		printf("Error while listening \n");
+		syslog(LOG_ERR, "Error: Listening failed =%s. Exiting ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	while (process_flag == false)
+	{
+		client_size = sizeof(struct sockaddr);
+
+		// step -5 Accepting connection
+		accept_fd = accept(socket_fd, (struct sockaddr *)&client_add, &client_size);
+		if (accept_fd == -1) // generating error
+		{
+			printf("Error while accepting \n");
+			syslog(LOG_ERR, "Error: Accepting failed =%s. Exiting ", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		metrics_add(METRIC_ACCEPTED, 1);
+		// to get the client address in a readable format
+		struct sockaddr_in *addr_in = (struct sockaddr_in *)&client_add;
+		char *addr_ip = inet_ntoa(addr_in->sin_addr); // using inet_ntoa function
+
+		AESD_LOG(LOG_DEBUG, "Connection succesful. Accepting connection from %s", addr_ip);
+
+		/*Adding below part for A6-P1*/
+
+		// allocating new node for the data
+		datap = (slist_data_t *)malloc(sizeof(slist_data_t));
+
+		SLIST_INSERT_HEAD(&head, datap, entries);
+
+		// Inserting thread parameters now
+		datap->thread_socket.client_fd = accept_fd;
+		datap->thread_socket.thread_complete = false;
+
+		pthread_create(&(datap->thread_socket.thread_id), // the thread id to be created
+					   NULL,							  // the thread attribute to be passed
+					   thread_handler,					  // the thread handler to be executed
+					   &datap->thread_socket			  // the thread parameter to be passed
+		);
+
+		AESD_LOG(LOG_DEBUG, "Threads created now waiting to exit");
+
+		SLIST_FOREACH(datap, &head, entries)
+		{
+
+			if (datap->thread_socket.thread_complete == true)
+			{
+				pthread_join(datap->thread_socket.thread_id, NULL);
+				SLIST_REMOVE(&head, datap, slist_data_s, entries);
+				free(datap);
+				break;
+			}
+		}
+
+		AESD_LOG(LOG_DEBUG, "Closed connection from %s", addr_ip);
+	}
+
+	// 9. Close sfd, accept_fd
+	close(accept_fd);
+	close(socket_fd);
+}
+
+/*PACKET FRAMING*/
+/*
+ * @function	:  Make room for at least min_space more received bytes, dropping consumed packets
+ * 				   and doubling the arena when needed. Invalidates previously returned packets
+ *
+ * @param		:  packet_framer_t *framer : framer of the connection, size_t min_space : bytes needed
+ * @return		:  location to receive into, NULL if the allocation failed
+ *
+ */
+char *framer_space(packet_framer_t *framer, size_t min_space)
+{
+	if (framer->protocol == FRAMER_INVALID)
+	{
+		errno = EMSGSIZE;
+		return NULL;
+	}
+	if (framer->size - framer->len < min_space)
+	{
+		// reclaim the consumed packets before growing
+		if (framer->start > 0)
+		{
+			memmove(framer->buff, framer->buff + framer->start, framer->len - framer->start);
+			framer->len -= framer->start;
+			framer->scanned -= framer->start;
+			framer->start = 0;
+		}
+		if (framer->size - framer->len < min_space)
+		{
+			size_t new_size = (framer->size != 0) ? framer->size : BUFFER_SIZE;
+			while (new_size - framer->len < min_space)
+				new_size *= 2;
+			char *new_buff = realloc(framer->buff, new_size);
+			if (new_buff == NULL)
+				return NULL;
+			framer->buff = new_buff;
+			framer->size = new_size;
+		}
+	}
+	return framer->buff + framer->len;
+}
+
+/*
+ * @function	:  Bytes to receive next: BUFFER_SIZE, or more of a larger binary frame. The request
+ * 				   grows with the bytes of the frame already received, so the arena only doubles
+ * 				   as the payload arrives instead of taking the size the header announces up front
+ *
+ * @param		:  packet_framer_t *framer : framer of the connection
+ * @return		:  size for framer_space and recv
+ *
+ */
+size_t framer_want(packet_framer_t *framer)
+{
+	size_t avail = framer->len - framer->start;
+	proto_header_t header;
+
+	if (framer->protocol != FRAMER_BINARY || avail < sizeof(header))
+		return BUFFER_SIZE;
+	memcpy(&header, framer->buff + framer->start, sizeof(header));
+	size_t frame_len = sizeof(header) + ntohl(header.length);
+	if (ntohl(header.length) > PROTO_MAX_PAYLOAD || frame_len <= avail + BUFFER_SIZE)
+		return BUFFER_SIZE;
+	if (frame_len - avail > avail)
+		return (avail > BUFFER_SIZE) ? avail : BUFFER_SIZE;
+	return frame_len - avail;
+}
+
+/*
+ * @function	:  Tell the protocol of the connection from its first bytes
+ *
+ * @param		:  packet_framer_t *framer : framer still in FRAMER_DETECT
+ * @return		:  NULL
+ *
+ */
+static void framer_detect(packet_framer_t *framer)
+{
+	size_t avail = framer->len - framer->start;
+	size_t compare = (avail < PROTO_MAGIC_LEN) ? avail : PROTO_MAGIC_LEN;
+
+	if (avail == 0)
+		return;
+	if (memcmp(framer->buff + framer->start, PROTO_MAGIC, compare) != 0)
+		framer->protocol = FRAMER_TEXT;
+	else if (avail >= PROTO_MAGIC_LEN)
+	{
+		framer->protocol = FRAMER_BINARY;
+		framer->start = framer->scanned = framer->start + PROTO_MAGIC_LEN;
+	}
+}
+
+/*
+ * @function	:  Extract the next complete binary frame, its header is kept in framer->header
+ *
+ * @param		:  packet_framer_t *framer : framer in FRAMER_BINARY, size_t *packet_len : payload size
+ * @return		:  start of the payload inside the arena, NULL if no complete frame is buffered
+ *
+ */
+static char *framer_next_frame(packet_framer_t *framer, size_t *packet_len)
+{
+	size_t avail = framer->len - framer->start;
+
+	if (avail < sizeof(proto_header_t))
+		return NULL;
+	memcpy(&framer->header, framer->buff + framer->start, sizeof(proto_header_t));
+	size_t payload_len = ntohl(framer->header.length);
+	if (payload_len > PROTO_MAX_PAYLOAD)
+	{
+		framer->protocol = FRAMER_INVALID;
+		return NULL;
+	}
+	if (avail - sizeof(proto_header_t) < payload_len)
+		return NULL;
+	char *payload = framer->buff + framer->start + sizeof(proto_header_t);
+	*packet_len = payload_len;
+	framer->start = framer->scanned = framer->start + sizeof(proto_header_t) + payload_len;
+	return payload;
+}
+
+/*
+ * @function	:  Extract the next complete newline terminated packet, only bytes not scanned by
+ * 				   an earlier call are searched. Binary connections get their next frame instead
+ *
+ * @param		:  packet_framer_t *framer : framer of the connection, size_t *packet_len : packet size
+ * @return		:  start of the packet inside the arena, NULL if no complete packet is buffered
+ *
+ */
+char *framer_next(packet_framer_t *framer, size_t *packet_len)
+{
+	if (framer->protocol == FRAMER_DETECT)
+		framer_detect(framer);
+	if (framer->protocol == FRAMER_BINARY)
+		return framer_next_frame(framer, packet_len);
+	if (framer->protocol != FRAMER_TEXT)
+		return NULL;
+
+	char *newline = memchr(framer->buff + framer->scanned, '\n', framer->len - framer->scanned);
+	if (newline == NULL)
+	{
+		framer->scanned = framer->len;
+		return NULL;
+	}
+	char *packet = framer->buff + framer->start;
+	*packet_len = newline + 1 - packet;
+	framer->start = framer->scanned = newline + 1 - framer->buff;
+	return packet;
+}
+
+/*
+ * @function	:  Extract the unterminated bytes left over when the client stops sending
+ *
+ * @param		:  packet_framer_t *framer : framer of the connection, size_t *packet_len : packet size
+ * @return		:  start of the partial packet, NULL if nothing is left
+ *
+ */
+char *framer_rest(packet_framer_t *framer, size_t *packet_len)
+{
+	// an incomplete binary frame is dropped
+	if (framer->start == framer->len || framer->protocol == FRAMER_BINARY || framer->protocol == FRAMER_INVALID)
+		return NULL;
+	char *packet = framer->buff + framer->start;
+	*packet_len = framer->len - framer->start;
+	framer->start = framer->scanned = framer->len;
+	return packet;
+}
+
+/*PACKET PROCESSING*/
+/*
+ * @function	:  Tell an AESDCHAR_IOCSEEKTO command from data to append
+ *
+ * @param		:  const char *packet : packet received from the client, size_t packet_len : its size
+ * @return		:  true for a seekto command
+ *
+ */
+static bool packet_is_seekto(const char *packet, size_t packet_len)
+{
+	size_t cmd_len = strlen("AESDCHAR_IOCSEEKTO:");
+
+	return packet_len >= cmd_len && memcmp(packet, "AESDCHAR_IOCSEEKTO:", cmd_len) == 0;
+}
+
+/*
+ * @function	:  Append data to the history with the selected backend
+ *
+ * @param		:  int data_fd : descriptor of file_path, const char *packet : data, size_t packet_len : its size
+ * @return		:  NULL
+ *
+ */
+static void append_packet(int data_fd, const char *packet, size_t packet_len)
+{
+	AESD_LOG(LOG_DEBUG, "writing to file");
+#ifndef USE_AESD_CHAR_DEVICE
+	// batched with the packets of the other connections, or copied into the mapped log
+	store_packet(packet, packet_len);
+#else
+	while (packet_len > 0)
+	{
+		ssize_t writeret = write(data_fd, packet, packet_len);
+
+		if (writeret == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			printf("Error write\n");
+			exit(1);
+		}
+		packet += writeret;
+		packet_len -= writeret;
+	}
+#endif
+}
+
+/*
+ * @function	:  Apply one received packet to the data file, either as an AESDCHAR_IOCSEEKTO
+ * 				   command adjusting the file position of data_fd or as data appended to it
+ *
+ * @param		:  int data_fd : descriptor of file_path the reply will be read from,
+ * 				   const char *packet : packet received from the client, size_t packet_len : its size,
+ * 				   uint64_t reply_from : stream position the reply starts from after a write, see data_stream_pos
+ * @return		:  0 on success, -1 on error
+ *
+ */
+int process_packet(int data_fd, const char *packet, size_t packet_len, uint64_t reply_from)
+{
+	size_t cmd_len = strlen("AESDCHAR_IOCSEEKTO:");
+
+	metrics_add(METRIC_PACKETS, 1);
+	if (packet_is_seekto(packet, packet_len)) // checking for command
+	{
+
+		struct aesd_seekto seekto;
+		char command[64];
+		char *save_ptr = NULL;
+		size_t arg_len = packet_len - cmd_len;
+
+		// the arguments are short, parse a null terminated copy
+		if (arg_len >= sizeof(command))
+			arg_len = sizeof(command) - 1;
+		memcpy(command, packet + cmd_len, arg_len);
+		command[arg_len] = '\0';
+
+		char *token = strtok_r(command, ",", &save_ptr);
+		if (token == NULL)
+		{
+			AESD_LOG(LOG_DEBUG, "Error: Invalid write command");
+			return -1;
+		}
+		// extracting write command and write command offset
+		seekto.write_cmd = strtoul(token, NULL, 10);
+		token = strtok_r(NULL, ",", &save_ptr);
+		if (token == NULL)
+		{
+			AESD_LOG(LOG_DEBUG, "Error: Invalid write command");
+			return -1;
+		}
+		seekto.write_cmd_offset = strtoul(token, NULL, 10);
+
+		AESD_LOG(LOG_DEBUG, "Command found:%s :%u, %u", "AESDCHAR_IOCSEEKTO", seekto.write_cmd, seekto.write_cmd_offset);
+		// check for successful ioctl command
+		if (ioctl(data_fd, AESDCHAR_IOCSEEKTO, &seekto) != 0)
+		{
+			AESD_LOG(LOG_DEBUG, "ioctl failed");
+			return -1;
+		}
+		AESD_LOG(LOG_DEBUG, "ioctl successful");
+		metrics_add(METRIC_SEEKS, 1);
+		return 0;
+	}
+
+	// Write the data received from client to the server if its not AESDCHAR_IOCSEEKTO command
+	append_packet(data_fd, packet, packet_len);
+	// O_APPEND or an earlier reply moved the offset, position it where the reply starts
+	data_stream_seek(data_fd, reply_from);
+	return 0;
+}
+
+/*BINARY PROTOCOL*/
+/*
+ * @function	:  Apply one binary request, see aesd-proto.h. PROTO_OP_READ leaves data_fd positioned
+ * 				   at the start of the requested range, the other requests leave the position alone
+ *
+ * @param		:  int data_fd : descriptor of file_path, const proto_header_t *header : request header,
+ * 				   const char *payload : its payload, size_t payload_len : payload size,
+ * 				   proto_reply_t *reply_head : filled with the reply header
+ * @return		:  bytes of history following the reply header
+ *
+ */
+static size_t process_frame(int data_fd, const proto_header_t *header, const char *payload, size_t payload_len,
+							proto_reply_t *reply_head)
+{
+	off_t position = lseek(data_fd, 0, SEEK_CUR);
+	uint64_t data_len = 0;
+
+	metrics_add(METRIC_PACKETS, 1);
+	memset(reply_head, 0, sizeof(*reply_head));
+	reply_head->opcode = header->opcode;
+	reply_head->status = PROTO_STATUS_OK;
+	if (header->flags != 0)
+		header = NULL;
+
+	switch ((header != NULL) ? header->opcode : 0)
+	{
+	case PROTO_OP_APPEND:
+		append_packet(data_fd, payload, payload_len);
+		// only seekto and reads move the file position
+		lseek(data_fd, position, SEEK_SET);
+		break;
+
+	case PROTO_OP_SEEKTO:
+		if (payload_len != sizeof(proto_seekto_t))
+		{
+			reply_head->status = PROTO_STATUS_BAD_REQUEST;
+			break;
+		}
+#ifdef USE_AESD_CHAR_DEVICE
+		proto_seekto_t request;
+		memcpy(&request, payload, sizeof(request));
+		struct aesd_seekto seekto = {.write_cmd = ntohl(request.write_cmd), .write_cmd_offset = ntohl(request.write_cmd_offset)};
+		if (ioctl(data_fd, AESDCHAR_IOCSEEKTO, &seekto) != 0)
+		{
+			AESD_LOG(LOG_DEBUG, "ioctl failed");
+			reply_head->status = PROTO_STATUS_FAILED;
+			break;
+		}
+		metrics_add(METRIC_SEEKS, 1);
+#else
+		reply_head->status = PROTO_STATUS_UNSUPPORTED;
+#endif
+		break;
+
+	case PROTO_OP_READ:
+		if (payload_len != sizeof(proto_read_t))
+		{
+			reply_head->status = PROTO_STATUS_BAD_REQUEST;
+			break;
+		}
+		proto_read_t range;
+		memcpy(&range, payload, sizeof(range));
+		uint64_t offset = be64toh(range.offset);
+		uint64_t length = be64toh(range.length);
+		off_t end = lseek(data_fd, 0, SEEK_END);
+#ifndef USE_AESD_CHAR_DEVICE
+		// the mapped log file is preallocated past the history
+		if (log_mode)
+			end = atomic_load_explicit(&data_log.committed, memory_order_acquire);
+#endif
+		if (end == -1)
+		{
+			reply_head->status = PROTO_STATUS_FAILED;
+			lseek(data_fd, position, SEEK_SET);
+			break;
+		}
+		if (offset == PROTO_READ_CURRENT)
+			offset = position;
+		if (offset > (uint64_t)end)
+			offset = end;
+		data_len = end - offset;
+		if (length > 0 && length < data_len)
+			data_len = length;
+		lseek(data_fd, offset, SEEK_SET);
+		break;
+
+	default:
+		reply_head->status = PROTO_STATUS_BAD_REQUEST;
+		break;
+	}
+	reply_head->length = htobe64(data_len);
+	return data_len;
+}
+
+/*
+ * @function	:  Queue a binary append for the writer thread instead of applying it with process_frame,
+ * 				   so a reactor keeps serving its other connections while the payload is written
+ *
+ * @param		:  const proto_header_t *header : request header, const char *payload : its payload in the framer,
+ * 				   size_t payload_len : payload size, write_request_t *request : request of the connection,
+ * 				   write_completion_t *completion : completion of the calling reactor, void *owner : the connection,
+ * 				   proto_reply_t *reply_head : filled with the reply header, sent once the completion arrives
+ * @return		:  true when queued, false when the request goes through process_frame
+ *
+ */
+static bool frame_queue_append(const proto_header_t *header, const char *payload, size_t payload_len,
+							   write_request_t *request, write_completion_t *completion, void *owner,
+							   proto_reply_t *reply_head)
+{
+#ifndef USE_AESD_CHAR_DEVICE
+	if (!log_mode && header->flags == 0 && header->opcode == PROTO_OP_APPEND)
+	{
+		metrics_add(METRIC_PACKETS, 1);
+		memset(reply_head, 0, sizeof(*reply_head));
+		reply_head->opcode = header->opcode;
+		reply_head->status = PROTO_STATUS_OK;
+		// the framer is not touched until the completion
+		writer_submit_async(request, payload, payload_len, completion, owner);
+		return true;
+	}
+#else
+	(void)header;
+	(void)payload;
+	(void)payload_len;
+	(void)request;
+	(void)completion;
+	(void)owner;
+	(void)reply_head;
+#endif
+	return false;
+}
+
+/*
+ * @function	:  Find the data_len bytes of history at the position of data_fd in memory, the reply
+ * 				   announced their length so a shorter memory source is not taken
+ *
+ * @param		:  int data_fd : positioned by process_frame, size_t data_len : bytes of the reply,
+ * 				   const char **data : the bytes, cache_snapshot_t *snapshot : to release after sending
+ * @return		:  true when found in memory, data_fd then points past them, false to read data_fd
+ *
+ */
+static bool frame_memory_source(int data_fd, size_t data_len, const char **data, cache_snapshot_t *snapshot)
+{
+	// device offsets shift with evictions, stream positions do not
+	uint64_t from = data_stream_pos(data_fd);
+	uint64_t reply_end;
+	size_t len = 0;
+
+	if (data_len > 0 && reply_memory_source(data_fd, data, &len, snapshot, &reply_end) && len >= data_len)
+	{
+		data_stream_seek(data_fd, from + data_len);
+		return true;
+	}
+	cache_release(snapshot);
+	data_stream_seek(data_fd, from);
+	return false;
+}
+
+/*
+ * @function	:  Start the reply of a binary request: its header, then data_len bytes of history
+ *
+ * @param		:  reply_state_t *reply : reply to start, int data_fd : positioned by process_frame,
+ * 				   const proto_reply_t *reply_head : header, size_t data_len : bytes following it,
+ * 				   cache_snapshot_t *snapshot : released with cache_release once the reply is finished
+ * @return		:  NULL
+ *
+ */
+static void frame_reply_begin(reply_state_t *reply, int data_fd, const proto_reply_t *reply_head, size_t data_len,
+							  cache_snapshot_t *snapshot)
+{
+	const char *data = NULL;
+
+	if (data_len == 0 || frame_memory_source(data_fd, data_len, &data, snapshot))
+		reply_start_memory(reply, data, data_len);
+	else
+		reply_start(reply, data_fd, REPLY_AUTO);
+	reply_set_limit(reply, data_len);
+	reply_set_head(reply, reply_head, sizeof(*reply_head));
+}
+
+/*
+ * @function	:  Apply a binary request from a blocking client socket and send its reply
+ *
+ * @param		:  int client_fd : client socket, int data_fd : descriptor of file_path,
+ * 				   const proto_header_t *header : request header, const char *payload : its payload,
+ * 				   size_t payload_len : payload size
+ * @return		:  0 on success, -1 on error
+ *
+ */
+static int send_frame_reply(int client_fd, int data_fd, const proto_header_t *header, const char *payload, size_t payload_len)
+{
+	uint64_t packet_us = metrics_now_us();
+	reply_state_t reply;
+	cache_snapshot_t snapshot = {0};
+	proto_reply_t reply_head;
+	int ret = 0;
+
+	size_t data_len = process_frame(data_fd, header, payload, payload_len, &reply_head);
+	frame_reply_begin(&reply, data_fd, &reply_head, data_len, &snapshot);
+	if (reply_send(&reply, client_fd) == -1)
+	{
+		AESD_LOG(LOG_ERR, "Error: Sending failed =%s", strerror(errno));
+		ret = -1;
+	}
+	reply_finish(&reply);
+	cache_release(&snapshot);
+	metrics_add(METRIC_BYTES_OUT, reply.sent);
+	metrics_record_latency(packet_us);
+	return ret;
+}
+
+/*THREAD HANDLER*/
+/*
+ * @function	:  Thread handler function for receiving and sending data
+ *
+ * @param		:  void *thread_parameters: thread parameters
+ * @return		:   void *thread_parameters
+ *
+ */
+void *thread_handler(void *thread_parameter)
+{
+	// get the parameter of the thread
+	thread_ipc *params = (thread_ipc *)thread_parameter;
+
+	metrics_add(METRIC_THREADS, 1);
+	serve_client(params->client_fd);
+	metrics_add(METRIC_THREADS, -1);
+	params->thread_complete = true;
+
+	return params;
+}
+
+/*CLIENT HANDLER*/
+/*
+ * @function	:  Send the data file back to the client from the current position of data_fd
+ *
+ * @param		:  int client_fd : blocking client socket, int data_fd : descriptor of file_path,
+ * 				   uint64_t *cursor : stream position following the previous reply, advanced in tail mode,
+ * 				   uint64_t packet_us : time the first packet answered by this reply was framed
+ * @return		:  0 on success, -1 on error
+ *
+ */
+static int send_reply(int client_fd, int data_fd, uint64_t *cursor, uint64_t packet_us)
+{
+	reply_state_t reply;
+	cache_snapshot_t snapshot;
+	uint64_t reply_end;
+	int ret = 0;
+
+	AESD_LOG(LOG_DEBUG, "reading from file");
+	reply_begin(&reply, data_fd, &snapshot, &reply_end);
+	if (reply_send(&reply, client_fd) == -1)
+	{
+		AESD_LOG(LOG_ERR, "Error: Sending failed =%s", strerror(errno));
+		ret = -1;
+	}
+	reply_finish(&reply);
+	cache_release(&snapshot);
+	metrics_add(METRIC_BYTES_OUT, reply.sent);
+	metrics_record_latency(packet_us);
+	if (tail_mode)
+	{
+		// the next reply of this connection continues where this one stopped
+		*cursor = reply_tail_pos(data_fd, reply_end);
+	}
+	return ret;
+}
+
+/*
+ * @function	:  Receive packets from a blocking client socket until at least one newline
+ * 				   terminated packet arrived, apply them and send the file contents back,
+ * 				   then close the client. With keep-alive every packet gets its own reply and
+ * 				   the connection stays open until the client closes it or stays idle too long.
+ * 				   In tail mode a reply only carries the history appended since the previous one
+ *
+ * @param		:  int client_fd : accepted client socket
+ * @return		:  NULL
+ *
+ */
+void serve_client(int client_fd)
+{
+
+	// Package storage related variables
+	bool packet_comp = false;
+	bool client_done = false;
+	ssize_t ret_recv = 0;
+	packet_framer_t framer = {0};
+	char *packet = NULL;
+	size_t packet_len = 0;
+	uint64_t cursor = 0; // stream position the next reply starts from, only moves in tail mode
+	uint64_t packet_us = 0; // framing time of the first packet not replied yet
+
+	metrics_add(METRIC_CLIENTS, 1);
+	int file_fd = open(file_path, O_CREAT | O_APPEND | O_RDWR, 0644); //opening file path
+	if (file_fd == -1)
+	{
+		printf("File open error for appending\n");
+		exit(1);
+	}
+
+	if (keepalive_timeout > 0)
+	{
+		// an idle client makes recv fail with EAGAIN
+		struct timeval idle = {.tv_sec = keepalive_timeout, .tv_usec = 0};
+		setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+	}
+
+	/*Packet reception, detection and storage logic*/
+	while (client_done == false)
+	{
+		size_t recv_len = framer_want(&framer);
+		char *recv_space = framer_space(&framer, recv_len);
+		if (recv_space == NULL)
+		{
+			if (framer.protocol == FRAMER_INVALID)
+			{
+				AESD_LOG(LOG_ERR, "Error: binary frame too large");
+				goto exit_thread;
+			}
+			printf("Realloc failed\n");
+			exit(1);
+		}
+
+		// the rest of a large binary frame is received in one piece
+		ret_recv = recv(client_fd, recv_space, recv_len, (recv_len > BUFFER_SIZE) ? MSG_WAITALL : 0);
 		if (ret_recv < 0)
 		{
-			printf("Error while receving data packets\n");
-			syslog(LOG_ERR, "Error: Receiving failed =%s. Exiting ", strerror(errno));
-			exit(EXIT_FAILURE);
+			if (errno == EINTR)
+				continue;
+			if (keepalive_timeout > 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				AESD_LOG(LOG_DEBUG, "Closing idle connection");
+			}
+			else
+			{
+				// a reset client only ends its own connection
+				AESD_LOG(LOG_ERR, "Error: Receiving failed =%s", strerror(errno));
+			}
+			goto exit_thread;
+		}
+		else if (ret_recv == 0)
+		{
+			// client stopped sending, whatever is left forms the last packet
+			packet = framer_rest(&framer, &packet_len);
+			if (packet != NULL)
+			{
+				if (!packet_comp)
+					packet_us = metrics_now_us();
+				if (process_packet(file_fd, packet, packet_len, cursor) == -1)
+				{
+					// only this connection ends, the others and the timer keep running
+					goto exit_thread;
+				}
+				packet_comp = true;
+			}
+			break;
+		}
+		framer.len += ret_recv;
+		metrics_add(METRIC_BYTES_IN, ret_recv);
+
+		/*Detect '\n', a single recv may complete several packets*/
+		while ((packet = framer_next(&framer, &packet_len)) != NULL)
+		{
+			// binary requests are answered one by one until the client closes
+			if (framer.protocol == FRAMER_BINARY)
+			{
+				if (send_frame_reply(client_fd, file_fd, &framer.header, packet, packet_len) == -1)
+				{
+					client_done = true;
+					break;
+				}
+				continue;
+			}
+			if (!packet_comp)
+				packet_us = metrics_now_us();
+			packet_comp = true;
+			AESD_LOG(LOG_DEBUG, "data packet received");
+
+			// Step-6 Write the data received from client, or apply the AESDCHAR_IOCSEEKTO command
+			if (process_packet(file_fd, packet, packet_len, cursor) == -1)
+			{
+				goto exit_thread;
+			}
+			if (keepalive_timeout > 0)
+			{
+				packet_comp = false;
+				if (send_reply(client_fd, file_fd, &cursor, packet_us) == -1)
+				{
+					client_done = true;
+					break;
+				}
+			}
+		}
+		if (keepalive_timeout == 0 && packet_comp)
+		{
+			client_done = true;
+		}
+	}
+	// Step-7 Sending the file contents to the client with the accept fd, without copying through userspace
+	if (framer.protocol != FRAMER_BINARY && (keepalive_timeout == 0 || packet_comp))
+	{
+		send_reply(client_fd, file_fd, &cursor, packet_us);
+	}
+
+exit_thread:
+	metrics_add(METRIC_CLIENTS, -1);
+	close(file_fd);
+
+	close(client_fd);
+	// Free the allocated buffer
+	free(framer.buff);
+}
+/*EPOLL REACTOR*/
+// Per-connection state of a client served by an epoll reactor
+typedef struct epoll_conn_s
+{
+	int client_fd;			 // non-blocking client socket
+	int data_fd;			 // file_path, open for the lifetime of the connection
+	packet_framer_t framer;	 // bytes received so far
+	bool packet_comp;		 // a packet was applied and still needs its reply
+	bool peer_closed;		 // recv returned 0, no more packets will arrive
+	bool replying;			 // sending file_path back
+	bool writing;			 // a packet is queued for the writer thread, resumed by its completion
+	write_request_t write;	 // request of the queued packet
+	write_completion_t *completion; // completion of the owning reactor
+	proto_reply_t frame_head; // reply header of a queued binary append
+	reply_state_t reply;	 // progress of the reply
+	cache_snapshot_t snapshot; // history cache snapshot the reply is sent from
+	uint64_t cursor;		 // stream position the next reply starts from, only moves in tail mode
+	uint64_t reply_end;		 // stream position following the reply, see reply_memory_source
+	uint64_t packet_us;		 // framing time of the first packet waiting for the reply
+	time_t last_active;		 // monotonic second of the last event, for the idle timeout
+	TAILQ_ENTRY(epoll_conn_s) entries; // position in the reactor's idle list
+} epoll_conn_t;
+
+// Connections of one reactor, least recently active first
+TAILQ_HEAD(epoll_conn_list, epoll_conn_s);
+
+/*
+ * @function	:  Current monotonic time in seconds, used for the keep-alive idle timeout
+ *
+ * @param		:  NULL
+ * @return		:  seconds since an arbitrary point
+ *
+ */
+static time_t monotonic_seconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+/*
+ * @function	:  Release a reactor connection and all of its descriptors
+ *
+ * @param		:  struct epoll_conn_list *conns : list of the owning reactor, epoll_conn_t *conn : connection to close
+ * @return		:  NULL
+ *
+ */
+static void epoll_conn_close(struct epoll_conn_list *conns, epoll_conn_t *conn)
+{
+	TAILQ_REMOVE(conns, conn, entries);
+	if (conn->replying)
+	{
+		reply_finish(&conn->reply);
+		cache_release(&conn->snapshot);
+	}
+	close(conn->data_fd);
+	close(conn->client_fd); // also removes it from the epoll interest list
+	free(conn->framer.buff);
+	free(conn);
+	metrics_add(METRIC_CLIENTS, -1);
+}
+
+/*
+ * @function	:  Start sending file_path back for the packets applied so far
+ *
+ * @param		:  epoll_conn_t *conn : connection that completed a packet
+ * @return		:  NULL
+ *
+ */
+static void epoll_conn_reply(epoll_conn_t *conn)
+{
+	conn->packet_comp = false;
+	conn->replying = true;
+	reply_begin(&conn->reply, conn->data_fd, &conn->snapshot, &conn->reply_end);
+}
+
+/*
+ * @function	:  Apply a packet like process_packet, except that data for the writer thread is only queued
+ * 				   so the reactor keeps serving its other connections while the packet is written
+ *
+ * @param		:  epoll_conn_t *conn : connection, const char *packet : packet in its framer, size_t packet_len : its size
+ * @return		:  1 when queued, the connection then waits for epoll_conn_written, 0 when applied, -1 on error
+ *
+ */
+static int epoll_conn_packet(epoll_conn_t *conn, const char *packet, size_t packet_len)
+{
+#ifndef USE_AESD_CHAR_DEVICE
+	if (!log_mode && !packet_is_seekto(packet, packet_len))
+	{
+		metrics_add(METRIC_PACKETS, 1);
+		// the framer is not touched until the completion
+		writer_submit_async(&conn->write, packet, packet_len, conn->completion, conn);
+		conn->writing = true;
+		return 1;
+	}
+#endif
+	return process_packet(conn->data_fd, packet, packet_len, conn->cursor);
+}
+
+/*
+ * @function	:  Advance the connection as far as possible without blocking: finish the pending
+ * 				   reply, apply buffered packets and drain the socket into the framer
+ *
+ * @param		:  epoll_conn_t *conn : connection with a pending event
+ * @return		:  1 when the connection is finished and should be closed, 0 when waiting for an event
+ *
+ */
+static int epoll_conn_service(epoll_conn_t *conn)
+{
+	char *packet = NULL;
+	size_t packet_len = 0;
+
+	while (1)
+	{
+		if (conn->writing)
+			return 0; // resumed by epoll_conn_written
+		if (conn->replying)
+		{
+			int ret = reply_send(&conn->reply, conn->client_fd);
+			if (ret == 0)
+				return 0; // resumed on EPOLLOUT
+			reply_finish(&conn->reply);
+			cache_release(&conn->snapshot);
+			conn->replying = false;
+			metrics_add(METRIC_BYTES_OUT, conn->reply.sent);
+			metrics_record_latency(conn->packet_us);
+			if (ret == -1)
+			{
+				AESD_LOG(LOG_ERR, "Error: Sending failed =%s", strerror(errno));
+				return 1;
+			}
+			if (tail_mode && conn->framer.protocol != FRAMER_BINARY)
+				conn->cursor = reply_tail_pos(conn->data_fd, conn->reply_end);
+			// binary connections stay open for the next request
+			if (conn->peer_closed || (keepalive_timeout == 0 && conn->framer.protocol != FRAMER_BINARY))
+				return 1;
+		}
+
+		/*Detect '\n' only in the bytes not scanned yet */
+		packet = framer_next(&conn->framer, &packet_len);
+		if (packet != NULL && conn->framer.protocol == FRAMER_BINARY)
+		{
+			proto_reply_t reply_head;
+
+			conn->packet_us = metrics_now_us();
+			if (frame_queue_append(&conn->framer.header, packet, packet_len, &conn->write, conn->completion, conn,
+								   &conn->frame_head))
+			{
+				conn->writing = true;
+				return 0;
+			}
+			size_t data_len = process_frame(conn->data_fd, &conn->framer.header, packet, packet_len, &reply_head);
+			frame_reply_begin(&conn->reply, conn->data_fd, &reply_head, data_len, &conn->snapshot);
+			conn->replying = true;
+			continue;
+		}
+		if (packet != NULL)
+		{
+			AESD_LOG(LOG_DEBUG, "data packet received");
+			if (!conn->packet_comp)
+				conn->packet_us = metrics_now_us();
+			int ret = epoll_conn_packet(conn, packet, packet_len);
+			if (ret == -1)
+				return 1;
+			conn->packet_comp = true;
+			if (ret == 1)
+				return 0;
+			// with keep-alive every packet gets its own reply
+			if (keepalive_timeout > 0)
+				epoll_conn_reply(conn);
+			continue;
+		}
+		if (conn->packet_comp)
+		{
+			// all packets completed by the last recv are applied, one reply then close
+			epoll_conn_reply(conn);
+			continue;
+		}
+		if (conn->peer_closed)
+		{
+			// whatever is left forms the last packet
+			packet = framer_rest(&conn->framer, &packet_len);
+			if (packet == NULL)
+				return 1;
+			conn->packet_us = metrics_now_us();
+			int ret = epoll_conn_packet(conn, packet, packet_len);
+			if (ret == -1)
+				return 1;
+			conn->packet_comp = true;
+			if (ret == 1)
+				return 0;
+			epoll_conn_reply(conn);
+			continue;
+		}
+
+		size_t recv_len = framer_want(&conn->framer);
+		char *recv_space = framer_space(&conn->framer, recv_len);
+		if (recv_space == NULL)
+		{
+			AESD_LOG(LOG_ERR, "Realloc failed");
+			return 1;
+		}
+		ssize_t ret_recv = recv(conn->client_fd, recv_space, recv_len, 0);
+		if (ret_recv == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			AESD_LOG(LOG_ERR, "Error: Receiving failed =%s", strerror(errno));
+			return 1;
+		}
+		if (ret_recv == 0)
+		{
+			conn->peer_closed = true;
+			continue;
+		}
+		conn->framer.len += ret_recv;
+		metrics_add(METRIC_BYTES_IN, ret_recv);
+	}
+}
+
+/*
+ * @function	:  Resume the connections whose packets the writer thread appended, in the order they were written
+ *
+ * @param		:  struct epoll_conn_list *conns : connections of the calling reactor,
+ * 				   write_completion_t *completion : its completion, readable, time_t now : time of the wakeup
+ * @return		:  NULL
+ *
+ */
+static void epoll_conn_written(struct epoll_conn_list *conns, write_completion_t *completion, time_t now)
+{
+	struct write_request_list done;
+	write_request_t *request;
+	uint64_t count;
+
+	if (read(completion->event_fd, &count, sizeof(count)) == -1)
+		return;
+	write_completion_collect(completion, &done);
+	while ((request = STAILQ_FIRST(&done)) != NULL)
+	{
+		epoll_conn_t *conn = request->owner;
+
+		STAILQ_REMOVE_HEAD(&done, entries);
+		conn->writing = false;
+		if (conn->framer.protocol == FRAMER_BINARY)
+		{
+			// the queued append is answered by its header alone
+			frame_reply_begin(&conn->reply, conn->data_fd, &conn->frame_head, 0, &conn->snapshot);
+			conn->replying = true;
+		}
+		else
+		{
+			// like process_packet, the reply starts at the cursor
+			data_stream_seek(conn->data_fd, conn->cursor);
+			// with keep-alive every packet gets its own reply
+			if (keepalive_timeout > 0)
+				epoll_conn_reply(conn);
+		}
+		if (epoll_conn_service(conn))
+		{
+			epoll_conn_close(conns, conn);
+			continue;
+		}
+		conn->last_active = now;
+		TAILQ_REMOVE(conns, conn, entries);
+		TAILQ_INSERT_TAIL(conns, conn, entries);
+	}
+}
+
+/*
+ * @function	:  Accept every pending connection on the listening socket and register it
+ * 				   edge-triggered with the calling reactor
+ *
+ * @param		:  int epoll_fd : epoll instance of the calling reactor, int listen_fd : listening socket,
+ * 				   struct epoll_conn_list *conns : connections of the calling reactor,
+ * 				   write_completion_t *completion : completion of the calling reactor
+ * @return		:  NULL
+ *
+ */
+static void epoll_accept(int epoll_fd, int listen_fd, struct epoll_conn_list *conns, write_completion_t *completion)
+{
+	struct sockaddr_in client_add;
+	socklen_t client_size;
+
+	while (1)
+	{
+		client_size = sizeof(client_add);
+		int client_fd = accept4(listen_fd, (struct sockaddr *)&client_add, &client_size, SOCK_NONBLOCK);
+		if (client_fd == -1)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				AESD_LOG(LOG_ERR, "Error: Accepting failed =%s", strerror(errno));
+			return;
+		}
+		AESD_LOG(LOG_DEBUG, "Connection succesful. Accepting connection from %s", inet_ntoa(client_add.sin_addr));
+
+		int data_fd = open(file_path, O_CREAT | O_APPEND | O_RDWR, 0644);
+		if (data_fd == -1)
+		{
+			AESD_LOG(LOG_ERR, "Error: File open failed =%s", strerror(errno));
+			close(client_fd);
+			continue;
+		}
+		epoll_conn_t *conn = calloc(1, sizeof(epoll_conn_t));
+		if (conn == NULL)
+		{
+			AESD_LOG(LOG_ERR, "Malloc failed!");
+			close(data_fd);
+			close(client_fd);
+			continue;
+		}
+		conn->client_fd = client_fd;
+		conn->data_fd = data_fd;
+		conn->completion = completion;
+		conn->last_active = monotonic_seconds();
+		metrics_add(METRIC_ACCEPTED, 1);
+		metrics_add(METRIC_CLIENTS, 1);
+		TAILQ_INSERT_TAIL(conns, conn, entries);
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = conn;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) == -1)
+		{
+			AESD_LOG(LOG_ERR, "Error: epoll_ctl failed =%s", strerror(errno));
+			epoll_conn_close(conns, conn);
+		}
+	}
+}
+
+/*
+ * @function	:  Reactor thread, multiplexes a listening socket and its share of the clients
+ * 				   on a private epoll instance
+ *
+ * @param		:  void *thread_parameter : int * to the listening socket, shared or owned by this reactor
+ * @return		:  NULL
+ *
+ */
+static void *epoll_reactor(void *thread_parameter)
+{
+	struct epoll_event events[EPOLL_MAX_EVENTS];
+	struct epoll_event ev;
+	struct epoll_conn_list conns;
+	write_completion_t completion;
+	epoll_conn_t *conn = NULL;
+	int listen_fd = *(int *)thread_parameter;
+
+	TAILQ_INIT(&conns);
+	metrics_add(METRIC_THREADS, 1);
+	int epoll_fd = epoll_create1(0);
+	if (epoll_fd == -1)
+	{
+		syslog(LOG_ERR, "Error: epoll_create1 failed =%s. Exiting.", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// the listening socket is shared, EPOLLEXCLUSIVE wakes a single reactor per connection
+	ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == -1)
+	{
+		syslog(LOG_ERR, "Error: epoll_ctl failed =%s. Exiting.", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	// packets written by the writer thread come back through the completion
+	ev.events = EPOLLIN;
+	ev.data.ptr = &completion;
+	if (write_completion_init(&completion) == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, completion.event_fd, &ev) == -1)
+	{
+		syslog(LOG_ERR, "Error: write completion setup failed =%s. Exiting.", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	while (process_flag == false)
+	{
+		// with keep-alive wake up every second to expire idle connections
+		int nfds = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, (keepalive_timeout > 0) ? 1000 : -1);
+		if (nfds == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			syslog(LOG_ERR, "Error: epoll_wait failed =%s. Exiting.", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		time_t now = monotonic_seconds();
+		bool written = false;
+		for (int i = 0; i < nfds; i++)
+		{
+			if (events[i].data.ptr == &completion)
+			{
+				written = true;
+				continue;
+			}
+			conn = events[i].data.ptr;
+			if (conn == NULL)
+			{
+				epoll_accept(epoll_fd, listen_fd, &conns, &completion);
+				continue;
+			}
+			if (epoll_conn_service(conn))
+			{
+				epoll_conn_close(&conns, conn);
+				continue;
+			}
+			// keep the list ordered by activity so expiry only looks at its head
+			conn->last_active = now;
+			TAILQ_REMOVE(&conns, conn, entries);
+			TAILQ_INSERT_TAIL(&conns, conn, entries);
+		}
+		// after the events, a resumed connection may be closed and later events of this pass point to it
+		if (written)
+			epoll_conn_written(&conns, &completion, now);
+
+		// a connection waiting for the writer stays until its completion
+		while (keepalive_timeout > 0 && (conn = TAILQ_FIRST(&conns)) != NULL &&
+			   !conn->writing && now - conn->last_active >= keepalive_timeout)
+		{
+			AESD_LOG(LOG_DEBUG, "Closing idle connection");
+			epoll_conn_close(&conns, conn);
+		}
+	}
+	close(completion.event_fd);
+	close(epoll_fd);
+	return NULL;
+}
+
+/*
+ * @function	:  Serve clients with worker_count epoll reactor threads instead of a thread per connection
+ *
+ * @param		:  NULL
+ * @return		:  NULL
+ *
+ */
+void epoll_server(void)
+{
+	if (listen(socket_fd, SOMAXCONN) == -1)
+	{
+		printf("Error while listening \n");
+		syslog(LOG_ERR, "Error: Listening failed =%s. Exiting ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK) == -1)
+	{
+		syslog(LOG_ERR, "Error: fcntl failed =%s. Exiting ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	pthread_t *reactors = malloc(sizeof(pthread_t) * worker_count);
+	if (reactors == NULL)
+	{
+		printf("Malloc failed!\n");
+		exit(EXIT_FAILURE);
+	}
+	syslog(LOG_DEBUG, "Starting %ld epoll reactors", worker_count);
+	for (long i = 0; i < worker_count; i++)
+	{
+		if (pthread_create(&reactors[i], NULL, epoll_reactor, &socket_fd) != 0)
+		{
+			printf("Error creating reactor thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (long i = 0; i < worker_count; i++)
+	{
+		pthread_join(reactors[i], NULL);
+	}
+	free(reactors);
+	close(socket_fd);
+}
+
+/*SHARDED LISTENERS*/
+// One shard per worker: a listener bound with SO_REUSEPORT and the epoll reactor accepting on it
+typedef struct
+{
+	pthread_t thread_id;
+	int listen_fd; // private listener, the kernel spreads new connections over all shards
+	long cpu;	   // core the shard is pinned to
+} shard_t;
+
+/*
+ * @function	:  Open one more listener on the address socket_fd is bound to
+ *
+ * @param		:  NULL
+ * @return		:  listening socket, -1 on error
+ *
+ */
+static int shard_listener_open(void)
+{
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+
+	if (getsockname(socket_fd, (struct sockaddr *)&addr, &addr_len) == -1)
+		return -1;
+	int listen_fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (listen_fd == -1)
+		return -1;
+	if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)) == -1 ||
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) == -1 ||
+		bind(listen_fd, (struct sockaddr *)&addr, addr_len) == -1 ||
+		listen(listen_fd, SOMAXCONN) == -1)
+	{
+		int saved_errno = errno;
+		close(listen_fd);
+		errno = saved_errno;
+		return -1;
+	}
+	return listen_fd;
+}
+
+/*
+ * @function	:  Shard thread, pins itself to its core and runs an epoll reactor on its own listener,
+ * 				   so accepting and setting up connections never leaves the core
+ *
+ * @param		:  void *thread_parameter : shard_t of the thread
+ * @return		:  NULL
+ *
+ */
+static void *shard_reactor(void *thread_parameter)
+{
+	shard_t *shard = thread_parameter;
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(shard->cpu, &cpus);
+	// a restricted cpuset only costs the locality, the shard still serves its listener
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+		syslog(LOG_DEBUG, "Shard could not be pinned to cpu %ld", shard->cpu);
+	return epoll_reactor(&shard->listen_fd);
+}
+
+/*
+ * @function	:  Serve clients with worker_count shards, each with an SO_REUSEPORT listener on
+ * 				   server_port and a reactor pinned to one online core. The kernel hashes incoming
+ * 				   connections over the listeners, no accept queue or lock is shared between cores
+ *
+ * @param		:  NULL
+ * @return		:  NULL
+ *
+ */
+void shard_server(void)
+{
+	long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpu_count <= 0)
+		cpu_count = 1;
+	shard_t *shards = calloc(worker_count, sizeof(shard_t));
+	if (shards == NULL)
+	{
+		printf("Malloc failed!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// the first shard listens on the socket bound by socket_connect
+	if (listen(socket_fd, SOMAXCONN) == -1 || fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK) == -1)
+	{
+		printf("Error while listening \n");
+		syslog(LOG_ERR, "Error: Listening failed =%s. Exiting ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	shards[0].listen_fd = socket_fd;
+	for (long i = 1; i < worker_count; i++)
+	{
+		shards[i].listen_fd = shard_listener_open();
+		if (shards[i].listen_fd == -1)
+		{
+			printf("Error while opening a shard listener \n");
+			syslog(LOG_ERR, "Error: Shard listener failed =%s. Exiting ", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	syslog(LOG_DEBUG, "Starting %ld shards", worker_count);
+	for (long i = 0; i < worker_count; i++)
+	{
+		shards[i].cpu = i % cpu_count;
+		if (pthread_create(&shards[i].thread_id, NULL, shard_reactor, &shards[i]) != 0)
+		{
+			printf("Error creating shard thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (long i = 0; i < worker_count; i++)
+	{
+		pthread_join(shards[i].thread_id, NULL);
+		if (shards[i].listen_fd != socket_fd)
+			close(shards[i].listen_fd);
+	}
+	free(shards);
+	close(socket_fd);
+}
+
+/*IO_URING REACTOR*/
+// Operation of an SQE, kept in the low bits of its user_data next to the connection pointer
+typedef enum
+{
+	URING_OP_ACCEPT = 0, // listening socket, no connection
+	URING_OP_TIMEOUT,	 // keep-alive expiry tick, no connection
+	URING_OP_RECV,
+	URING_OP_WRITE,
+	URING_OP_READ,
+	URING_OP_SEND,
+	URING_OP_WRITTEN, // writer thread completion, no connection
+} uring_op_t;
+#define URING_OP_MASK (7UL)
+
+// Per-connection state of a client served by an io_uring reactor, operations of one connection
+// never overlap except for a chain of linked writes
+typedef struct uring_conn_s
+{
+	int client_fd;			 // blocking client socket, io_uring waits for it
+	int data_fd;			 // file_path, open for the lifetime of the connection
+	packet_framer_t framer;	 // bytes received so far
+	unsigned inflight;		 // SQEs of this connection not completed yet
+	bool packet_comp;		 // a packet was applied and still needs its reply
+	bool peer_closed;		 // recv returned 0, no more packets will arrive
+	bool closing;			 // failed or idle, freed once inflight drops to zero
+	bool replying;			 // sending file_path back
+	bool tx_done;			 // nothing left to read for the reply
+	const char *tx;			 // reply bytes not sent yet, in tx_buff or in the mapped history
+	size_t tx_len;			 // size of tx
+	const char *tx_after;	 // memory sent once tx is, the history following a binary reply header
+	size_t tx_after_len;	 // size of tx_after
+	size_t tx_limit;		 // history bytes still to be read for the reply, SIZE_MAX until end of file
+	proto_reply_t frame_head; // reply header of the binary request being answered
+	size_t sent;			 // reply bytes sent
+	char *tx_buff;			 // URING_TX_SIZE bytes read from data_fd, allocated for the first read
+	cache_snapshot_t snapshot; // history cache snapshot tx points into
+	uint64_t cursor;		 // stream position the next reply starts from, only moves in tail mode
+	uint64_t reply_end;		 // stream position following the reply, see reply_memory_source
+	write_request_t write;	 // packet queued for the writer thread, counted in inflight
+	uint64_t packet_us;		 // framing time of the first packet waiting for the reply
+	time_t last_active;		 // monotonic second of the last completion, for the idle timeout
+	TAILQ_ENTRY(uring_conn_s) entries; // position in the reactor's idle list
+} uring_conn_t;
+
+TAILQ_HEAD(uring_conn_list, uring_conn_s);
+
+// One reactor thread with its own ring
+typedef struct
+{
+	uring_t ring;
+	struct uring_conn_list conns;	  // least recently active first
+	struct sockaddr_in client_add;	  // peer of the pending accept
+	socklen_t client_size;
+	struct __kernel_timespec tick;	  // keep-alive expiry period
+	write_completion_t completion;	  // packets the writer thread appended for the connections
+	uint64_t written;				  // eventfd count read by the queued URING_OP_WRITTEN
+} uring_reactor_t;
+
+/*
+ * @function	:  Get an SQE of the reactor ring, submitting the queued ones when the ring is full
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor
+ * @return		:  cleared SQE
+ *
+ */
+static struct io_uring_sqe *uring_reactor_sqe(uring_reactor_t *reactor)
+{
+	struct io_uring_sqe *sqe = uring_get_sqe(&reactor->ring);
+
+	while (sqe == NULL)
+	{
+		if (uring_submit(&reactor->ring, 0) == -1 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+		{
+			syslog(LOG_ERR, "Error: io_uring_enter failed =%s. Exiting.", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		sqe = uring_get_sqe(&reactor->ring);
+	}
+	return sqe;
+}
+
+/*
+ * @function	:  Queue an operation of a connection, it is submitted with the next batch
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, uring_conn_t *conn : owner,
+ * 				   uint8_t opcode : IORING_OP_*, uring_op_t op : tag of the completion,
+ * 				   int fd : file, const void *addr : buffer, size_t len : its size
+ * @return		:  the SQE, flags may still be adjusted before the next submit
+ *
+ */
+static struct io_uring_sqe *uring_conn_queue(uring_reactor_t *reactor, uring_conn_t *conn, uint8_t opcode,
+											 uring_op_t op, int fd, const void *addr, size_t len)
+{
+	struct io_uring_sqe *sqe = uring_reactor_sqe(reactor);
+
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)addr;
+	sqe->len = len;
+	if (opcode == IORING_OP_READ || opcode == IORING_OP_WRITE)
+		sqe->off = (uint64_t)-1; // the file position, like read/write
+	if (opcode == IORING_OP_SEND)
+		sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (uintptr_t)conn | op;
+	conn->inflight++;
+	return sqe;
+}
+
+/*
+ * @function	:  Queue the accept of the next client on the shared listening socket
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor
+ * @return		:  NULL
+ *
+ */
+static void uring_queue_accept(uring_reactor_t *reactor)
+{
+	struct io_uring_sqe *sqe = uring_reactor_sqe(reactor);
+
+	reactor->client_size = sizeof(reactor->client_add);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = socket_fd;
+	sqe->addr = (uintptr_t)&reactor->client_add;
+	sqe->addr2 = (uintptr_t)&reactor->client_size;
+	sqe->user_data = URING_OP_ACCEPT;
+}
+
+/*
+ * @function	:  Queue the next keep-alive expiry tick
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor
+ * @return		:  NULL
+ *
+ */
+static void uring_queue_tick(uring_reactor_t *reactor)
+{
+	struct io_uring_sqe *sqe = uring_reactor_sqe(reactor);
+
+	sqe->opcode = IORING_OP_TIMEOUT;
+	sqe->addr = (uintptr_t)&reactor->tick;
+	sqe->len = 1;
+	sqe->user_data = URING_OP_TIMEOUT;
+}
+
+/*
+ * @function	:  Queue the read of the writer completion, it completes once packets of the connections are written
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor
+ * @return		:  NULL
+ *
+ */
+static void uring_queue_written(uring_reactor_t *reactor)
+{
+	struct io_uring_sqe *sqe = uring_reactor_sqe(reactor);
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = reactor->completion.event_fd;
+	sqe->addr = (uintptr_t)&reactor->written;
+	sqe->len = sizeof(reactor->written);
+	sqe->off = (uint64_t)-1;
+	sqe->user_data = URING_OP_WRITTEN;
+}
+
+/*
+ * @function	:  Release a reactor connection, deferred while operations are in flight: shutting the
+ * 				   socket down completes them, the last completion frees the connection
+ *
+ * @param		:  uring_reactor_t *reactor : owning reactor, uring_conn_t *conn : connection to close
+ * @return		:  NULL
+ *
+ */
+static void uring_conn_close(uring_reactor_t *reactor, uring_conn_t *conn)
+{
+	if (conn->inflight > 0)
+	{
+		if (!conn->closing)
+		{
+			conn->closing = true;
+			shutdown(conn->client_fd, SHUT_RDWR);
+		}
+		return;
+	}
+	TAILQ_REMOVE(&reactor->conns, conn, entries);
+	close(conn->data_fd);
+	close(conn->client_fd);
+	free(conn->framer.buff);
+	free(conn->tx_buff);
+	cache_release(&conn->snapshot);
+	free(conn);
+	metrics_add(METRIC_CLIENTS, -1);
+}
+
+/*
+ * @function	:  Start sending file_path back for the packets applied so far
+ *
+ * @param		:  uring_conn_t *conn : connection that completed a packet
+ * @return		:  NULL
+ *
+ */
+static void uring_conn_reply(uring_conn_t *conn)
+{
+	conn->packet_comp = false;
+	conn->replying = true;
+	conn->sent = 0;
+	conn->tx_len = 0;
+	conn->tx_after_len = 0;
+	conn->tx_limit = SIZE_MAX;
+	// a reply found in memory is sent as a whole, otherwise it is read until end of file
+	conn->tx_done = reply_memory_source(conn->data_fd, &conn->tx, &conn->tx_len, &conn->snapshot, &conn->reply_end);
+}
+
+/*
+ * @function	:  Start the reply of a binary request: frame_head, then data_len bytes of history
+ *
+ * @param		:  uring_conn_t *conn : connection, size_t data_len : bytes following the header
+ * @return		:  NULL
+ *
+ */
+static void uring_conn_frame_reply(uring_conn_t *conn, size_t data_len)
+{
+	conn->replying = true;
+	conn->sent = 0;
+	conn->tx = (const char *)&conn->frame_head;
+	conn->tx_len = sizeof(conn->frame_head);
+	conn->tx_after_len = 0;
+	conn->tx_limit = data_len;
+	conn->tx_done = (data_len == 0);
+	if (data_len > 0 && frame_memory_source(conn->data_fd, data_len, &conn->tx_after, &conn->snapshot))
+	{
+		conn->tx_after_len = data_len;
+		conn->tx_done = true;
+	}
+}
+
+/*
+ * @function	:  Apply a binary request and start its reply, an append for the writer thread is only
+ * 				   queued and answered from its completion
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, uring_conn_t *conn : connection,
+ * 				   const char *payload : request payload, size_t payload_len : its size
+ * @return		:  1 when queued, 0 when the reply started
+ *
+ */
+static int uring_conn_frame(uring_reactor_t *reactor, uring_conn_t *conn, const char *payload, size_t payload_len)
+{
+	conn->packet_us = metrics_now_us();
+	if (frame_queue_append(&conn->framer.header, payload, payload_len, &conn->write, &reactor->completion, conn,
+						   &conn->frame_head))
+	{
+		conn->inflight++;
+		return 1;
+	}
+	uring_conn_frame_reply(conn, process_frame(conn->data_fd, &conn->framer.header, payload, payload_len, &conn->frame_head));
+	return 0;
+}
+
+/*
+ * @function	:  Apply the complete packets buffered in the framer. Seekto commands and the mapped log
+ * 				   are applied right away, data for the char device is queued as a chain of linked writes
+ * 				   which the kernel runs in order, data for the file backend is queued for the writer
+ * 				   thread one packet at a time. Stops after one packet with keep-alive and before a
+ * 				   seekto command, which counts the entries written before it
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, uring_conn_t *conn : connection with no operation in flight
+ * @return		:  number of writes queued, -1 on error
+ *
+ */
+static int uring_conn_packets(uring_reactor_t *reactor, uring_conn_t *conn)
+{
+	struct io_uring_sqe *sqe = NULL;
+	char *packet = NULL;
+	size_t packet_len = 0;
+	int writes = 0;
+
+	// a chain split over two submissions would not stay ordered
+	if (uring_sq_space(&reactor->ring) < URING_MAX_LINK)
+		uring_submit(&reactor->ring, 0);
+
+	while (writes < URING_MAX_LINK)
+	{
+		size_t start = conn->framer.start;
+		size_t scanned = conn->framer.scanned;
+
+		packet = framer_next(&conn->framer, &packet_len);
+		if (packet == NULL)
+			break;
+		if (conn->framer.protocol == FRAMER_BINARY)
+		{
+			// binary requests are answered one by one
+			return uring_conn_frame(reactor, conn, packet, packet_len);
 		}
-		else if (ret_recv == 0)
+		AESD_LOG(LOG_DEBUG, "data packet received");
+		if (!conn->packet_comp)
+			conn->packet_us = metrics_now_us();
+#ifdef USE_AESD_CHAR_DEVICE
+		if (!packet_is_seekto(packet, packet_len))
+		{
+			// the framer is not touched until the writes completed
+			sqe = uring_conn_queue(reactor, conn, IORING_OP_WRITE, URING_OP_WRITE, conn->data_fd, packet, packet_len);
+			sqe->flags |= IOSQE_IO_LINK;
+			metrics_add(METRIC_PACKETS, 1);
+			writes++;
+			conn->packet_comp = true;
+			if (keepalive_timeout > 0)
+				break;
+			continue;
+		}
+		if (writes > 0)
 		{
+			conn->framer.start = start;
+			conn->framer.scanned = scanned;
 			break;
 		}
-
-		/*Detect '\n' */
-		for (i = 0; i < BUFFER_SIZE; i++)
+#else
+		(void)start;
+		(void)scanned;
+		if (!log_mode && !packet_is_seekto(packet, packet_len))
 		{
+			// the writer thread appends it, the completion comes back like the last write of a chain
+			writer_submit_async(&conn->write, packet, packet_len, &reactor->completion, conn);
+			metrics_add(METRIC_PACKETS, 1);
+			conn->inflight++;
+			conn->packet_comp = true;
+			return 1;
+		}
+#endif
+		if (process_packet(conn->data_fd, packet, packet_len, conn->cursor) == -1)
+			return -1;
+		conn->packet_comp = true;
+		// with keep-alive every packet gets its own reply
+		if (keepalive_timeout > 0)
+			break;
+	}
+	if (sqe != NULL)
+		sqe->flags &= ~IOSQE_IO_LINK; // the chain ends with the last write
+	return writes;
+}
+
+/*
+ * @function	:  Queue the next operation of a connection that has none in flight: the next part of
+ * 				   the reply, the writes of the buffered packets or a receive
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, uring_conn_t *conn : connection to advance
+ * @return		:  1 when the connection is finished and should be closed, 0 when an operation was queued
+ *
+ */
+static int uring_conn_advance(uring_reactor_t *reactor, uring_conn_t *conn)
+{
+	char *packet = NULL;
+	size_t packet_len = 0;
 
-			if (buff[i] == '\n')
+	while (1)
+	{
+		if (conn->replying)
+		{
+			if (conn->tx_len == 0 && conn->tx_after_len > 0)
 			{
-				packet_comp = true;
-				i++;
-				printf("data packet receiving completed\n");
-				syslog(LOG_DEBUG, "data packet received");
-				break;
+				conn->tx = conn->tx_after;
+				conn->tx_len = conn->tx_after_len;
+				conn->tx_after_len = 0;
+			}
+			if (conn->tx_len > 0)
+			{
+				uring_conn_queue(reactor, conn, IORING_OP_SEND, URING_OP_SEND, conn->client_fd, conn->tx, conn->tx_len);
+				return 0;
+			}
+			if (!conn->tx_done)
+			{
+				if (conn->tx_buff == NULL && (conn->tx_buff = malloc(URING_TX_SIZE)) == NULL)
+				{
+					AESD_LOG(LOG_ERR, "Malloc failed!");
+					return 1;
+				}
+				uring_conn_queue(reactor, conn, IORING_OP_READ, URING_OP_READ, conn->data_fd, conn->tx_buff,
+								 (conn->tx_limit < URING_TX_SIZE) ? conn->tx_limit : URING_TX_SIZE);
+				return 0;
 			}
+			conn->replying = false;
+			cache_release(&conn->snapshot);
+			metrics_add(METRIC_BYTES_OUT, conn->sent);
+			metrics_record_latency(conn->packet_us);
+			if (tail_mode && conn->framer.protocol != FRAMER_BINARY)
+				conn->cursor = reply_tail_pos(conn->data_fd, conn->reply_end);
+			// binary connections stay open for the next request
+			if (conn->peer_closed || (keepalive_timeout == 0 && conn->framer.protocol != FRAMER_BINARY))
+				return 1;
 		}
-		j += i; // to get packet size of till null character received
-		data_count += i;
 
-		/*reallocate to a larger buffer now as static buffer can
-			only accomodate upto fixed size*/
-		output_buffer = (char *)realloc(output_buffer, (j + 1));
-		if (output_buffer == NULL)
+		int writes = uring_conn_packets(reactor, conn);
+		if (writes == -1)
+			return 1;
+		if (writes > 0)
+			return 0; // resumed by the last write completion
+		if (conn->replying)
+			continue; // a binary request started its reply
+		if (conn->packet_comp)
 		{
-			printf("Realloc failed\n");
-			exit(1);
+			// all packets completed by the last recv are applied, one reply then close
+			uring_conn_reply(conn);
+			continue;
+		}
+		if (conn->peer_closed)
+		{
+			// whatever is left forms the last packet
+			packet = framer_rest(&conn->framer, &packet_len);
+			if (packet == NULL)
+				return 1;
+			conn->packet_us = metrics_now_us();
+			if (process_packet(conn->data_fd, packet, packet_len, conn->cursor) == -1)
+				return 1;
+			uring_conn_reply(conn);
+			continue;
 		}
 
-		strncat(output_buffer, buff, j + 1);
+		size_t recv_len = framer_want(&conn->framer);
+		char *recv_space = framer_space(&conn->framer, recv_len);
+		if (recv_space == NULL)
+		{
+			AESD_LOG(LOG_ERR, "Realloc failed");
+			return 1;
+		}
+		uring_conn_queue(reactor, conn, IORING_OP_RECV, URING_OP_RECV, conn->client_fd, recv_space, recv_len);
+		return 0;
+	}
+}
 
-		memset(buff, 0, BUFFER_SIZE);
+/*
+ * @function	:  Apply the completion of an operation of a connection and queue the next one
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, uring_conn_t *conn : owner of the operation,
+ * 				   uring_op_t op : completed operation, int res : its result, negative errno on failure
+ * @return		:  NULL
+ *
+ */
+static void uring_conn_complete(uring_reactor_t *reactor, uring_conn_t *conn, uring_op_t op, int res)
+{
+	conn->inflight--;
+	if (conn->closing)
+	{
+		if (conn->inflight == 0)
+			uring_conn_close(reactor, conn);
+		return;
 	}
-	int file_fd = open(file_path, O_CREAT | O_APPEND | O_RDWR); //opening file path 
-	if (file_fd == -1)
+	if (res < 0 && res != -EINTR && res != -EAGAIN)
 	{
-		printf("File open error for appending\n");
-		exit(1);
+		// a reset client only ends its own connection, the rest of a write chain is cancelled
+		AESD_LOG(LOG_ERR, "Error: %s failed =%s", (op == URING_OP_RECV) ? "Receiving" : (op == URING_OP_SEND) ? "Sending" : "File access", strerror(-res));
+		uring_conn_close(reactor, conn);
+		return;
+	}
+	switch (op)
+	{
+	case URING_OP_RECV:
+		if (res == 0)
+			conn->peer_closed = true;
+		else if (res > 0)
+		{
+			conn->framer.len += res;
+			metrics_add(METRIC_BYTES_IN, res);
+		}
+		break;
+	case URING_OP_WRITE:
+		if (conn->inflight == 0 && conn->framer.protocol == FRAMER_BINARY)
+		{
+			// the queued append is answered by its header alone
+			uring_conn_frame_reply(conn, 0);
+		}
+		else if (conn->inflight == 0)
+		{
+			// like process_packet, the reply starts at the cursor
+			data_stream_seek(conn->data_fd, conn->cursor);
+			if (keepalive_timeout > 0)
+				uring_conn_reply(conn);
+		}
+		break;
+	case URING_OP_READ:
+		if (res == 0 && conn->tx_limit != SIZE_MAX)
+		{
+			// history evicted since the header announced its length, the client would lose the framing
+			AESD_LOG(LOG_ERR, "Error: Sending failed =%s", strerror(ENODATA));
+			uring_conn_close(reactor, conn);
+			return;
+		}
+		if (res == 0)
+			conn->tx_done = true;
+		else if (res > 0)
+		{
+			conn->tx = conn->tx_buff;
+			conn->tx_len = res;
+			conn->tx_limit -= res;
+			if (conn->tx_limit == 0)
+				conn->tx_done = true;
+		}
+		break;
+	case URING_OP_SEND:
+		if (res > 0)
+		{
+			conn->tx += res;
+			conn->tx_len -= res;
+			conn->sent += res;
+		}
+		break;
+	default:
+		break;
 	}
+	if (conn->inflight == 0 && uring_conn_advance(reactor, conn))
+		uring_conn_close(reactor, conn);
+}
 
-	while (1)
+/*
+ * @function	:  Set up a connection for an accepted client and queue its first receive
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, int client_fd : accepted client socket
+ * @return		:  NULL
+ *
+ */
+static void uring_accept(uring_reactor_t *reactor, int client_fd)
+{
+	AESD_LOG(LOG_DEBUG, "Connection succesful. Accepting connection from %s", inet_ntoa(reactor->client_add.sin_addr));
+
+	int data_fd = open(file_path, O_CREAT | O_APPEND | O_RDWR, 0644);
+	if (data_fd == -1)
+	{
+		AESD_LOG(LOG_ERR, "Error: File open failed =%s", strerror(errno));
+		close(client_fd);
+		return;
+	}
+	uring_conn_t *conn = calloc(1, sizeof(uring_conn_t));
+	if (conn == NULL)
+	{
+		AESD_LOG(LOG_ERR, "Malloc failed!");
+		close(data_fd);
+		close(client_fd);
+		return;
+	}
+	conn->client_fd = client_fd;
+	conn->data_fd = data_fd;
+	conn->last_active = monotonic_seconds();
+	metrics_add(METRIC_ACCEPTED, 1);
+	metrics_add(METRIC_CLIENTS, 1);
+	TAILQ_INSERT_TAIL(&reactor->conns, conn, entries);
+	if (uring_conn_advance(reactor, conn))
+		uring_conn_close(reactor, conn);
+}
+
+/*
+ * @function	:  Complete the writes of the connections whose packets the writer thread appended
+ *
+ * @param		:  uring_reactor_t *reactor : calling reactor, time_t now : time of the completion
+ * @return		:  NULL
+ *
+ */
+static void uring_written(uring_reactor_t *reactor, time_t now)
+{
+	struct write_request_list done;
+	write_request_t *request;
+
+	write_completion_collect(&reactor->completion, &done);
+	while ((request = STAILQ_FIRST(&done)) != NULL)
 	{
+		uring_conn_t *conn = request->owner;
 
-		if (strncmp(output_buffer, "AESDCHAR_IOCSEEKTO:", strlen("AESDCHAR_IOCSEEKTO:")) == 0) // checking for command
+		STAILQ_REMOVE_HEAD(&done, entries);
+		if (!conn->closing)
 		{
-			printf("seekto command found \n");
+			conn->last_active = now;
+			TAILQ_REMOVE(&reactor->conns, conn, entries);
+			TAILQ_INSERT_TAIL(&reactor->conns, conn, entries);
+		}
+		uring_conn_complete(reactor, conn, URING_OP_WRITE, request->packet_len);
+	}
+}
 
-			struct aesd_seekto seekto;
-			char *token = strtok(output_buffer + strlen("AESDCHAR_IOCSEEKTO:"), ",");
-			if (token == NULL)
-			{
-				syslog(LOG_DEBUG, "Error: Invalid write command\n");
-				exit_func();
-			}
-			// extracting write command and write command offset
-			seekto.write_cmd = strtoul(token, NULL, 10);
-			token = strtok(NULL, ",");
-			if (token == NULL)
-			{
-				syslog(LOG_DEBUG, "Error: Invalid write command\n");
-				exit_func();
-			}
-			seekto.write_cmd_offset = strtoul(token, NULL, 10);
+/*
+ * @function	:  Reactor thread, accepts and serves its share of the clients through one io_uring:
+ * 				   every pass submits all queued operations with a single system call and waits for
+ * 				   at least one completion
+ *
+ * @param		:  void *thread_parameter : unused
+ * @return		:  NULL
+ *
+ */
+static void *uring_reactor(void *thread_parameter)
+{
+	uring_reactor_t reactor;
+	struct io_uring_cqe *cqe = NULL;
+	uring_conn_t *conn = NULL;
+
+	memset(&reactor, 0, sizeof(reactor));
+	TAILQ_INIT(&reactor.conns);
+	reactor.tick.tv_sec = 1;
+	metrics_add(METRIC_THREADS, 1);
+	if (uring_init(&reactor.ring, URING_ENTRIES) == -1)
+	{
+		syslog(LOG_ERR, "Error: io_uring_setup failed =%s. Exiting.", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	if (write_completion_init(&reactor.completion) == -1)
+	{
+		syslog(LOG_ERR, "Error: eventfd failed =%s. Exiting.", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// every reactor keeps one accept queued on the shared listening socket
+	uring_queue_accept(&reactor);
+	uring_queue_written(&reactor);
+	if (keepalive_timeout > 0)
+		uring_queue_tick(&reactor);
+
+	while (process_flag == false)
+	{
+		if (uring_submit(&reactor.ring, 1) == -1 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+		{
+			syslog(LOG_ERR, "Error: io_uring_enter failed =%s. Exiting.", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		time_t now = monotonic_seconds();
+		while ((cqe = uring_peek_cqe(&reactor.ring)) != NULL)
+		{
+			uint64_t user_data = cqe->user_data;
+			int res = cqe->res;
 
-			syslog(LOG_DEBUG, "Command found:%s :%u, %u\n", "AESDCHAR_IOCSEEKTO", seekto.write_cmd, seekto.write_cmd_offset);
-			// check for successful ioctl command
-			if (ioctl(file_fd, AESDCHAR_IOCSEEKTO, &seekto) != 0)
+			uring_cqe_seen(&reactor.ring);
+			conn = (uring_conn_t *)(uintptr_t)(user_data & ~URING_OP_MASK);
+			if (conn == NULL)
 			{
-				syslog(LOG_DEBUG, "ioctl failed\n");
-				exit_func();
+				if ((user_data & URING_OP_MASK) == URING_OP_TIMEOUT)
+				{
+					uring_queue_tick(&reactor);
+					continue;
+				}
+				if ((user_data & URING_OP_MASK) == URING_OP_WRITTEN)
+				{
+					uring_written(&reactor, now);
+					uring_queue_written(&reactor);
+					continue;
+				}
+				if (res >= 0)
+					uring_accept(&reactor, res);
+				else if (res != -EINTR && res != -ECONNABORTED && res != -EAGAIN)
+					AESD_LOG(LOG_ERR, "Error: Accepting failed =%s", strerror(-res));
+				uring_queue_accept(&reactor);
+				continue;
 			}
-			else
+			if (!conn->closing)
 			{
-				syslog(LOG_DEBUG, "ioctl successful\n");
-				printf("ioctl successful\n");
+				// keep the list ordered by activity so expiry only looks at its head
+				conn->last_active = now;
+				TAILQ_REMOVE(&reactor.conns, conn, entries);
+				TAILQ_INSERT_TAIL(&reactor.conns, conn, entries);
 			}
+			uring_conn_complete(&reactor, conn, user_data & URING_OP_MASK, res);
 		}
 
-		// Step-6 Write the data received from client to the server if its not AESDCHAR_IOCSEEKTO command
-		else
+		while (keepalive_timeout > 0 && (conn = TAILQ_FIRST(&reactor.conns)) != NULL &&
+			   !conn->closing && now - conn->last_active >= keepalive_timeout)
 		{
-#ifndef USE_AESD_CHAR_DEVICE
-			ret = pthread_mutex_lock(&mutex_lock);
+			AESD_LOG(LOG_DEBUG, "Closing idle connection");
+			uring_conn_close(&reactor, conn);
+		}
+	}
+	uring_exit(&reactor.ring);
+	close(reactor.completion.event_fd);
+	return NULL;
+}
 
-			if (ret)
-			{
-				printf("Mutex lock error before write\n");
-				exit(1);
-			}
+/*
+ * @function	:  Serve clients with worker_count io_uring reactor threads. Kernels without io_uring or
+ * 				   without the operations used here, and sandboxes blocking it, are served by epoll_server
+ *
+ * @param		:  NULL
+ * @return		:  NULL
+ *
+ */
+void uring_server(void)
+{
+	static const uint8_t uring_ops[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+										IORING_OP_READ, IORING_OP_WRITE, IORING_OP_TIMEOUT};
+	uring_t probe_ring;
 
-#endif
-			syslog(LOG_DEBUG, "writing to file \n");
-			// printf("output buffer is %s\n", output_buffer);
-			int writeret = write(file_fd, output_buffer, strlen(output_buffer));
+	if (uring_init(&probe_ring, 4) == -1)
+	{
+		printf("io_uring unavailable, using epoll\n");
+		syslog(LOG_WARNING, "io_uring unavailable =%s, using epoll", strerror(errno));
+		epoll_server();
+		return;
+	}
+	// reads and writes at the file position need IORING_FEAT_RW_CUR_POS
+	if (uring_probe(&probe_ring, uring_ops, sizeof(uring_ops)) == -1 || !(probe_ring.features & IORING_FEAT_RW_CUR_POS))
+	{
+		printf("io_uring lacks the needed operations, using epoll\n");
+		syslog(LOG_WARNING, "io_uring lacks the needed operations, using epoll");
+		uring_exit(&probe_ring);
+		epoll_server();
+		return;
+	}
+	uring_exit(&probe_ring);
+
+	if (listen(socket_fd, SOMAXCONN) == -1)
+	{
+		printf("Error while listening \n");
+		syslog(LOG_ERR, "Error: Listening failed =%s. Exiting ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	pthread_t *reactors = malloc(sizeof(pthread_t) * worker_count);
+	if (reactors == NULL)
+	{
+		printf("Malloc failed!\n");
+		exit(EXIT_FAILURE);
+	}
+	syslog(LOG_DEBUG, "Starting %ld io_uring reactors", worker_count);
+	for (long i = 0; i < worker_count; i++)
+	{
+		if (pthread_create(&reactors[i], NULL, uring_reactor, NULL) != 0)
+		{
+			printf("Error creating reactor thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (long i = 0; i < worker_count; i++)
+	{
+		pthread_join(reactors[i], NULL);
+	}
+	free(reactors);
+	close(socket_fd);
+}
+
+/*WORKER POOL*/
+// One slot of the work queue, sequence tells producers and consumers whose turn it is
+typedef struct
+{
+	atomic_size_t sequence;
+	int client_fd;
+} fd_queue_cell_t;
+
+// Bounded lock-free MPMC queue of accepted client fds, the semaphores only
+// put idle workers to sleep and stall the acceptor when the queue is full
+typedef struct
+{
+	fd_queue_cell_t *cells;
+	size_t mask; // capacity - 1, capacity is a power of two
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+	sem_t items; // queued fds
+	sem_t slots; // free cells
+} fd_queue_t;
 
-			if (writeret == -1)
+fd_queue_t work_queue;
+
+/*
+ * @function	:  Allocate the work queue with at least depth cells
+ *
+ * @param		:  fd_queue_t *queue : queue to initialize, long depth : requested capacity
+ * @return		:  0 on success, -1 on error
+ *
+ */
+static int fd_queue_init(fd_queue_t *queue, long depth)
+{
+	size_t capacity = 1;
+
+	while (capacity < (size_t)depth)
+		capacity <<= 1;
+
+	queue->cells = malloc(sizeof(fd_queue_cell_t) * capacity);
+	if (queue->cells == NULL)
+		return -1;
+	for (size_t i = 0; i < capacity; i++)
+		atomic_init(&queue->cells[i].sequence, i);
+	queue->mask = capacity - 1;
+	atomic_init(&queue->enqueue_pos, 0);
+	atomic_init(&queue->dequeue_pos, 0);
+	if (sem_init(&queue->items, 0, 0) == -1 || sem_init(&queue->slots, 0, capacity) == -1)
+		return -1;
+	return 0;
+}
+
+/*
+ * @function	:  Claim a free cell and publish client_fd in it, the caller must own a slot
+ *
+ * @param		:  fd_queue_t *queue : work queue, int client_fd : accepted client
+ * @return		:  NULL
+ *
+ */
+static void fd_queue_push(fd_queue_t *queue, int client_fd)
+{
+	size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+
+	while (1)
+	{
+		fd_queue_cell_t *cell = &queue->cells[pos & queue->mask];
+		size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+													  memory_order_relaxed, memory_order_relaxed))
 			{
-				printf("Error write\n");
-				exit(1);
+				cell->client_fd = client_fd;
+				atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+				return;
 			}
-#ifndef USE_AESD_CHAR_DEVICE
-			ret = pthread_mutex_unlock(&mutex_lock);
+		}
+		else if (diff < 0)
+		{
+			// the consumer of this cell has not released it yet
+			sched_yield();
+			pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+		}
+		else
+		{
+			pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+		}
+	}
+}
+
+/*
+ * @function	:  Take the oldest client fd out of the queue, the caller must own an item
+ *
+ * @param		:  fd_queue_t *queue : work queue
+ * @return		:  the dequeued client fd
+ *
+ */
+static int fd_queue_pop(fd_queue_t *queue)
+{
+	size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
 
-			if (ret)
+	while (1)
+	{
+		fd_queue_cell_t *cell = &queue->cells[pos & queue->mask];
+		size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+													  memory_order_relaxed, memory_order_relaxed))
 			{
-				printf("Mutex unlock error after read/send\n");
-				exit(1);
+				int client_fd = cell->client_fd;
+				atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+				return client_fd;
 			}
-#endif
 		}
-		break;
+		else if (diff < 0)
+		{
+			// the producer of this cell has not published it yet
+			sched_yield();
+			pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+		}
+		else
+		{
+			pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+		}
 	}
-	// Step-7 Reading from the file & Sending to the client with the accept fd
-	char send_buffer[BUFFER_SIZE];
-	memset(&send_buffer[0], 0, BUFFER_SIZE);
-	syslog(LOG_DEBUG, "reading from file n");
-	while (1)
-	{ // for reading and writing to socket
+}
 
-		ret = read(file_fd, send_buffer, BUFFER_SIZE);
-		// read until no characters left
-		if (ret <= 0)
-			break;
+/*
+ * @function	:  Pool worker, serves queued clients one after the other
+ *
+ * @param		:  void *thread_parameter : unused
+ * @return		:  NULL
+ *
+ */
+static void *pool_worker(void *thread_parameter)
+{
+	metrics_add(METRIC_THREADS, 1);
+	while (process_flag == false)
+	{
+		if (sem_wait(&work_queue.items) == -1)
+			continue; // EINTR
+		int client_fd = fd_queue_pop(&work_queue);
+		sem_post(&work_queue.slots);
+		metrics_add(METRIC_QUEUED, -1);
 
-		send(params->client_fd, send_buffer, strlen(send_buffer), 0); // send back to socket
+		serve_client(client_fd);
 	}
-	// printf("send buffer is %s\n", send_buffer);
+	return NULL;
+}
 
-	// exit_thread:
-	close(file_fd);
-	params->thread_complete = true;
+/*
+ * @function	:  Serve clients with worker_count pre-spawned threads, the main thread only accepts
+ * 				   and stops accepting while queue_depth connections are already waiting
+ *
+ * @param		:  NULL
+ * @return		:  NULL
+ *
+ */
+void pool_server(void)
+{
+	struct sockaddr_in client_add;
+	socklen_t client_size;
 
-	close(params->client_fd);
-	// Free the allocated buffer
-	free(output_buffer);
+	if (fd_queue_init(&work_queue, queue_depth) == -1)
+	{
+		printf("Work queue allocation failed\n");
+		exit(EXIT_FAILURE);
+	}
+	if (listen(socket_fd, SOMAXCONN) == -1)
+	{
+		printf("Error while listening \n");
+		syslog(LOG_ERR, "Error: Listening failed =%s. Exiting ", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
 
-	return params;
+	syslog(LOG_DEBUG, "Starting %ld pool workers", worker_count);
+	for (long i = 0; i < worker_count; i++)
+	{
+		pthread_t worker;
+		if (pthread_create(&worker, NULL, pool_worker, NULL) != 0)
+		{
+			printf("Error creating worker thread\n");
+			exit(EXIT_FAILURE);
+		}
+		pthread_detach(worker);
+	}
+
+	while (process_flag == false)
+	{
+		// backpressure, leave new connections in the listen backlog while the queue is full
+		if (sem_trywait(&work_queue.slots) == -1)
+		{
+			AESD_LOG(LOG_DEBUG, "Work queue full, waiting for a worker");
+			if (sem_wait(&work_queue.slots) == -1)
+				continue;
+		}
+
+		client_size = sizeof(client_add);
+		int client_fd = accept(socket_fd, (struct sockaddr *)&client_add, &client_size);
+		if (client_fd == -1)
+		{
+			sem_post(&work_queue.slots);
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			printf("Error while accepting \n");
+			syslog(LOG_ERR, "Error: Accepting failed =%s. Exiting ", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		AESD_LOG(LOG_DEBUG, "Connection succesful. Accepting connection from %s", inet_ntoa(client_add.sin_addr));
+
+		metrics_add(METRIC_ACCEPTED, 1);
+		metrics_add(METRIC_QUEUED, 1);
+		fd_queue_push(&work_queue, client_fd);
+		sem_post(&work_queue.items);
+	}
+	close(socket_fd);
 }
+
 /*Exit Fucntion*/
 /*
  * @function	: Exit function for gracefule exit
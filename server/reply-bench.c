@@ -0,0 +1,209 @@
+/**********************************************************************************************************************************
+ * @File name (reply-bench.c)
+ * @File Description: (throughput of the aesdsocket reply methods when sending a multi-megabyte history over loopback TCP)
+ * @Author Name (AYSWARIYA KANNAN)
+ **************************************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "aesd-reply.h"
+
+#define BENCH_LINE_SIZE (80)
+
+atomic_size_t bytes_received; // drained by the receiver thread
+
+/*
+ * @function	:  Receiver thread, drains the client end of the connection as fast as possible
+ *
+ * @param		:  void *thread_parameter : pointer to the client socket
+ * @return		:  NULL
+ *
+ */
+static void *receiver(void *thread_parameter)
+{
+	int client_fd = *(int *)thread_parameter;
+	static char buff[1 << 16];
+	ssize_t ret;
+
+	while ((ret = recv(client_fd, buff, sizeof(buff), 0)) > 0)
+		atomic_fetch_add(&bytes_received, ret);
+	return NULL;
+}
+
+/*
+ * @function	:  Fill path with size bytes of newline terminated packets
+ *
+ * @param		:  const char *path : history file, size_t size : bytes to write
+ * @return		:  NULL
+ *
+ */
+static void create_history(const char *path, size_t size)
+{
+	char line[BENCH_LINE_SIZE];
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+
+	if (fd == -1)
+	{
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+	memset(line, 'a', sizeof(line));
+	line[sizeof(line) - 1] = '\n';
+	for (size_t written = 0; written < size; written += sizeof(line))
+	{
+		size_t len = (size - written < sizeof(line)) ? size - written : sizeof(line);
+		if (write(fd, line, len) != (ssize_t)len)
+		{
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+	}
+	close(fd);
+}
+
+/*
+ * @function	:  Connect a blocking TCP pair over loopback
+ *
+ * @param		:  int *server_fd : end the reply is sent from, int *client_fd : end the receiver drains
+ * @return		:  NULL
+ *
+ */
+static void connect_pair(int *server_fd, int *client_fd)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (listen_fd == -1 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+		listen(listen_fd, 1) == -1 || getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) == -1)
+	{
+		perror("listen");
+		exit(EXIT_FAILURE);
+	}
+	*client_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (*client_fd == -1 || connect(*client_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+	{
+		perror("connect");
+		exit(EXIT_FAILURE);
+	}
+	*server_fd = accept(listen_fd, NULL, NULL);
+	if (*server_fd == -1)
+	{
+		perror("accept");
+		exit(EXIT_FAILURE);
+	}
+	close(listen_fd);
+}
+
+/*
+ * @function	:  Main function, times every reply method on the same history
+ *
+ * @param		:  argc, argv : [-s size in MB] [-i iterations] [-f history file]
+ * @return		:  0 on success
+ *
+ */
+int main(int argc, char *argv[])
+{
+	const char *path = "/var/tmp/reply-bench-data";
+	bool create = true;
+	size_t size = 16 << 20;
+	int iterations = 20;
+	int opt;
+	const struct
+	{
+		const char *name;
+		reply_method_t method;
+	} methods[] = {
+		{"read/send", REPLY_COPY},
+		{"sendfile", REPLY_SENDFILE},
+		{"splice", REPLY_SPLICE},
+	};
+
+	while ((opt = getopt(argc, argv, "s:i:f:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			size = strtoul(optarg, NULL, 10) << 20;
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'f':
+			// an existing history such as /dev/aesdchar, sent from the start each time
+			path = optarg;
+			create = false;
+			break;
+		default:
+			printf("Usage: %s [-s size in MB] [-i iterations] [-f history file]\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (create)
+		create_history(path, size);
+
+	int data_fd = open(path, O_RDONLY);
+	if (data_fd == -1)
+	{
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%-10s %12s %12s\n", "method", "MB/s", "ms/reply");
+	for (size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+	{
+		int server_fd, client_fd;
+		pthread_t receiver_thread;
+		struct timespec begin, end;
+		size_t expected = 0;
+		reply_state_t reply;
+
+		connect_pair(&server_fd, &client_fd);
+		atomic_store(&bytes_received, 0);
+		pthread_create(&receiver_thread, NULL, receiver, &client_fd);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (int i = 0; i < iterations; i++)
+		{
+			lseek(data_fd, 0, SEEK_SET);
+			reply_start(&reply, data_fd, methods[m].method);
+			if (reply_send(&reply, server_fd) == -1)
+			{
+				perror(methods[m].name);
+				exit(EXIT_FAILURE);
+			}
+			expected += lseek(data_fd, 0, SEEK_CUR);
+			reply_finish(&reply);
+		}
+		while (atomic_load(&bytes_received) < expected)
+			sched_yield();
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		shutdown(server_fd, SHUT_RDWR);
+		pthread_join(receiver_thread, NULL);
+		close(server_fd);
+		close(client_fd);
+
+		double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+		printf("%-10s %12.1f %12.3f\n", methods[m].name, expected / seconds / (1 << 20),
+			   seconds * 1e3 / iterations);
+	}
+	close(data_fd);
+	if (create)
+		unlink(path);
+	return 0;
+}
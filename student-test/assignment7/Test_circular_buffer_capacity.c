@@ -0,0 +1,133 @@
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+#define TEST_CAPACITY 5
+#define TEST_SLOTS 8
+#define TEST_WRITES 12
+
+static char test_data[TEST_WRITES][16];
+
+/**
+ * Add write number @param index to @param buffer
+ * @return the buffptr of the entry evicted by it, NULL when none was
+ */
+static const char *add_write(struct aesd_circular_buffer *buffer, int index)
+{
+    struct aesd_buffer_entry entry;
+
+    snprintf(test_data[index], sizeof(test_data[index]), "write%d\n", index);
+    entry.buffptr = test_data[index];
+    entry.size = strlen(test_data[index]);
+    return aesd_circular_buffer_add_entry(buffer, &entry);
+}
+
+/**
+ * The slot count is the capacity rounded up to a power of two
+ */
+void test_circular_buffer_slots()
+{
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, aesd_circular_buffer_slots(1), "1 entry needs 1 slot");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(8, aesd_circular_buffer_slots(5), "5 entries need 8 slots");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(8, aesd_circular_buffer_slots(8), "8 entries need 8 slots");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(AESDCHAR_DEFAULT_ENTRY_SLOTS,
+                                     aesd_circular_buffer_slots(AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED),
+                                     "the default capacity fits the embedded array");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(AESDCHAR_MAX_ENTRIES_LIMIT, aesd_circular_buffer_slots(AESDCHAR_MAX_ENTRIES_LIMIT),
+                                     "the largest capacity is a power of two");
+}
+
+/**
+ * aesd_circular_buffer_init keeps the assignment capacity in the embedded array
+ */
+void test_circular_buffer_default_capacity()
+{
+    struct aesd_circular_buffer buffer;
+    size_t offset = 0;
+
+    aesd_circular_buffer_init(&buffer);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(buffer.default_entry, buffer.entry, "init uses the embedded array");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, buffer.capacity, "default capacity");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(AESDCHAR_DEFAULT_ENTRY_SLOTS - 1, buffer.entry_mask, "default slots");
+
+    for (int i = 0; i < TEST_WRITES; i++)
+    {
+        add_write(&buffer, i);
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED, buffer.count, "count stops at the capacity");
+    TEST_ASSERT_TRUE_MESSAGE(buffer.full, "buffer is full");
+    struct aesd_buffer_entry *entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &offset);
+    TEST_ASSERT_NOT_NULL_MESSAGE(entry, "offset 0 is held");
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[TEST_WRITES - AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED], entry->buffptr,
+                                  "the oldest entry is the first one not evicted");
+}
+
+/**
+ * A capacity below the slot count wraps in_offs and out_offs around the slots and keeps
+ * exactly capacity entries in write order
+ */
+void test_circular_buffer_capacity_wraparound()
+{
+    struct aesd_buffer_entry entries[TEST_SLOTS];
+    struct aesd_circular_buffer buffer;
+    size_t entry_start = 0;
+    size_t offset = 0;
+
+    memset(entries, 0, sizeof(entries));
+    aesd_circular_buffer_init_entries(&buffer, entries, TEST_SLOTS, TEST_CAPACITY);
+    for (int i = 0; i < TEST_CAPACITY; i++)
+    {
+        TEST_ASSERT_NULL_MESSAGE(add_write(&buffer, i), "nothing is evicted below the capacity");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i + 1, buffer.count, "count grows with every write");
+    }
+    TEST_ASSERT_TRUE_MESSAGE(buffer.full, "full at the capacity, before the slots are used up");
+
+    for (int i = TEST_CAPACITY; i < TEST_WRITES; i++)
+    {
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[i - TEST_CAPACITY], add_write(&buffer, i),
+                                      "each write beyond the capacity evicts the oldest entry");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(TEST_CAPACITY, buffer.count, "count stays at the capacity");
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(TEST_WRITES % TEST_SLOTS, buffer.in_offs, "in_offs wrapped around the slots");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((TEST_WRITES - TEST_CAPACITY) % TEST_SLOTS, buffer.out_offs,
+                                     "out_offs wrapped around the slots");
+
+    // the held entries run from the last slot over the wrap to the first ones
+    for (int i = 0; i < TEST_CAPACITY; i++)
+    {
+        struct aesd_buffer_entry *entry = aesd_circular_buffer_entry_at(&buffer, i, &entry_start);
+        TEST_ASSERT_NOT_NULL_MESSAGE(entry, "entry is held");
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[TEST_WRITES - TEST_CAPACITY + i], entry->buffptr, "entries keep write order");
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(entry, aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, entry_start, &offset),
+                                      "the start of each entry is found across the wrap");
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(0, offset, "found at its first byte");
+    }
+    TEST_ASSERT_NULL_MESSAGE(aesd_circular_buffer_entry_at(&buffer, TEST_CAPACITY, &entry_start),
+                             "no entry beyond the capacity");
+}
+
+/**
+ * A capacity of one keeps only the last write
+ */
+void test_circular_buffer_capacity_one()
+{
+    struct aesd_buffer_entry entries[1];
+    struct aesd_circular_buffer buffer;
+    size_t offset = 0;
+
+    memset(entries, 0, sizeof(entries));
+    aesd_circular_buffer_init_entries(&buffer, entries, aesd_circular_buffer_slots(1), 1);
+    TEST_ASSERT_NULL_MESSAGE(add_write(&buffer, 0), "first write evicts nothing");
+    for (int i = 1; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[i - 1], add_write(&buffer, i), "every write evicts the previous one");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, buffer.count, "one entry held");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, buffer.in_offs, "in_offs stays on the only slot");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, buffer.out_offs, "out_offs stays on the only slot");
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(strlen(test_data[i]), buffer.total_size, "size of the last write");
+    }
+    struct aesd_buffer_entry *entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 1, &offset);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[3], entry->buffptr, "offset 1 is in the last write");
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(1, offset, "at its second byte");
+}
@@ -0,0 +1,130 @@
+#include "unity.h"
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+#define TEST_CAPACITY 4
+#define TEST_SLOTS 8
+#define TEST_WRITES 11
+
+static char test_data[TEST_WRITES][2 * TEST_WRITES + 2];
+
+/**
+ * Size of write number @param index, every write has a different size
+ */
+static size_t write_size(int index)
+{
+    return 2 * index + 1;
+}
+
+/**
+ * Add write number @param index to @param buffer
+ * @return the buffptr of the entry evicted by it, NULL when none was
+ */
+static const char *add_write(struct aesd_circular_buffer *buffer, int index)
+{
+    struct aesd_buffer_entry entry;
+
+    memset(test_data[index], 'a' + index, write_size(index));
+    test_data[index][write_size(index)] = '\0';
+    entry.buffptr = test_data[index];
+    entry.size = write_size(index);
+    entry.start_offs = 12345; // set by the buffer
+    return aesd_circular_buffer_add_entry(buffer, &entry);
+}
+
+/**
+ * After every write, evicting or not, end_offs counts all bytes written, total_size the bytes held
+ * and start_offs of each held entry the bytes written before it
+ */
+void test_circular_buffer_eviction_offsets()
+{
+    struct aesd_buffer_entry entries[TEST_SLOTS];
+    struct aesd_circular_buffer buffer;
+    size_t written = 0;
+
+    memset(entries, 0, sizeof(entries));
+    aesd_circular_buffer_init_entries(&buffer, entries, TEST_SLOTS, TEST_CAPACITY);
+    for (int i = 0; i < TEST_WRITES; i++)
+    {
+        int oldest = (i + 1 > TEST_CAPACITY) ? i + 1 - TEST_CAPACITY : 0;
+        size_t held = 0;
+        size_t entry_start = 0;
+
+        add_write(&buffer, i);
+        written += write_size(i);
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(written, buffer.end_offs, "end_offs counts every byte written");
+
+        // the held entries start where the writes before them ended
+        size_t start_offs = 0;
+        for (int j = 0; j < oldest; j++)
+        {
+            start_offs += write_size(j);
+        }
+        for (int j = oldest; j <= i; j++)
+        {
+            struct aesd_buffer_entry *entry = aesd_circular_buffer_entry_at(&buffer, j - oldest, &entry_start);
+
+            TEST_ASSERT_NOT_NULL_MESSAGE(entry, "entry is held");
+            TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[j], entry->buffptr, "entries keep write order");
+            TEST_ASSERT_EQUAL_UINT_MESSAGE(start_offs, entry->start_offs, "start_offs is the bytes written before");
+            TEST_ASSERT_EQUAL_UINT_MESSAGE(held, entry_start, "entry_at counts from the oldest entry held");
+            start_offs += entry->size;
+            held += entry->size;
+        }
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(held, buffer.total_size, "total_size is the bytes held");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i + 1 - oldest, buffer.count, "count of the held entries");
+    }
+}
+
+/**
+ * An evicted entry is returned to the caller to free, and its slot is cleared until it is reused
+ */
+void test_circular_buffer_eviction_slot()
+{
+    struct aesd_buffer_entry entries[TEST_SLOTS];
+    struct aesd_circular_buffer buffer;
+
+    memset(entries, 0, sizeof(entries));
+    aesd_circular_buffer_init_entries(&buffer, entries, TEST_SLOTS, TEST_CAPACITY);
+    for (int i = 0; i < TEST_CAPACITY; i++)
+    {
+        TEST_ASSERT_NULL_MESSAGE(add_write(&buffer, i), "nothing is evicted below the capacity");
+    }
+    TEST_ASSERT_TRUE_MESSAGE(buffer.full, "full at the capacity");
+
+    uint32_t evicted_slot = buffer.out_offs;
+    size_t total_size = buffer.total_size;
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[0], add_write(&buffer, TEST_CAPACITY), "the oldest entry is evicted");
+    TEST_ASSERT_NULL_MESSAGE(entries[evicted_slot].buffptr, "the evicted slot no longer points to the freed data");
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(0, entries[evicted_slot].size, "the evicted slot is empty");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((evicted_slot + 1) & buffer.entry_mask, buffer.out_offs, "out_offs moved past it");
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(total_size - write_size(0) + write_size(TEST_CAPACITY), buffer.total_size,
+                                   "total_size drops the evicted entry and adds the new one");
+    TEST_ASSERT_TRUE_MESSAGE(buffer.full, "still full");
+}
+
+/**
+ * After evictions file position 0 is the first byte of the oldest entry held
+ */
+void test_circular_buffer_eviction_fpos()
+{
+    struct aesd_buffer_entry entries[TEST_SLOTS];
+    struct aesd_circular_buffer buffer;
+    size_t offset = 0;
+
+    memset(entries, 0, sizeof(entries));
+    aesd_circular_buffer_init_entries(&buffer, entries, TEST_SLOTS, TEST_CAPACITY);
+    for (int i = 0; i < TEST_WRITES; i++)
+    {
+        add_write(&buffer, i);
+    }
+    struct aesd_buffer_entry *entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &offset);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[TEST_WRITES - TEST_CAPACITY], entry->buffptr, "position 0 is the oldest entry");
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(0, offset, "at its first byte");
+
+    entry = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, buffer.total_size - 1, &offset);
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(test_data[TEST_WRITES - 1], entry->buffptr, "the last position is the newest entry");
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(write_size(TEST_WRITES - 1) - 1, offset, "at its last byte");
+    TEST_ASSERT_NULL_MESSAGE(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, buffer.total_size, &offset),
+                             "evicted bytes do not extend the positions");
+}
@@ -0,0 +1,134 @@
+#include "unity.h"
+#include <string.h>
+#include "../../aesd-char-driver/aesd-circular-buffer.h"
+
+#define TEST_WRITES 20
+
+static char test_data[TEST_WRITES][TEST_WRITES + 1];
+
+/**
+ * Fill @param buffer with TEST_WRITES entries, entry i holding i + 1 bytes, so that the
+ * default capacity wraps and evicts the first ones
+ */
+static void fill_buffer(struct aesd_circular_buffer *buffer)
+{
+    struct aesd_buffer_entry entry;
+
+    aesd_circular_buffer_init(buffer);
+    for (int i = 0; i < TEST_WRITES; i++)
+    {
+        memset(test_data[i], 'a' + i, i + 1);
+        test_data[i][i + 1] = '\0';
+        entry.buffptr = test_data[i];
+        entry.size = i + 1;
+        aesd_circular_buffer_add_entry(buffer, &entry);
+    }
+}
+
+/**
+ * Nothing is found in an empty buffer
+ */
+void test_circular_buffer_search_empty()
+{
+    struct aesd_circular_buffer buffer;
+    size_t offset = 0;
+
+    aesd_circular_buffer_init(&buffer);
+    TEST_ASSERT_NULL_MESSAGE(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, 0, &offset),
+                             "offset 0 of an empty buffer");
+}
+
+/**
+ * The first and the last byte of every entry are found in that entry
+ */
+void test_circular_buffer_search_entry_boundaries()
+{
+    struct aesd_circular_buffer buffer;
+    size_t entry_start = 0;
+    size_t offset = 0;
+
+    fill_buffer(&buffer);
+    for (uint32_t i = 0; i < buffer.count; i++)
+    {
+        struct aesd_buffer_entry *entry = aesd_circular_buffer_entry_at(&buffer, i, &entry_start);
+
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(entry, aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, entry_start, &offset),
+                                      "first byte of the entry");
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(0, offset, "offset of the first byte");
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(entry,
+                                      aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, entry_start + entry->size - 1, &offset),
+                                      "last byte of the entry");
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(entry->size - 1, offset, "offset of the last byte");
+    }
+}
+
+/**
+ * Positions at and past the end of the held bytes are not found, the returned offset is left alone
+ */
+void test_circular_buffer_search_end()
+{
+    struct aesd_circular_buffer buffer;
+    size_t offset = 12345;
+
+    fill_buffer(&buffer);
+    TEST_ASSERT_NULL_MESSAGE(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, buffer.total_size, &offset),
+                             "the position following the last byte");
+    TEST_ASSERT_NULL_MESSAGE(aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, buffer.total_size + 100, &offset),
+                             "a position far past the end");
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(12345, offset, "offset is only set when found");
+}
+
+/**
+ * Every position of a wrapped buffer gives the same entry and byte as walking the entries in order
+ */
+void test_circular_buffer_search_every_offset()
+{
+    struct aesd_circular_buffer buffer;
+    size_t entry_start = 0;
+    size_t offset = 0;
+    size_t position = 0;
+
+    fill_buffer(&buffer);
+    TEST_ASSERT_TRUE_MESSAGE(buffer.out_offs + buffer.count > buffer.entry_mask + 1, "the entries wrap around the slots");
+    for (uint32_t i = 0; i < buffer.count; i++)
+    {
+        struct aesd_buffer_entry *entry = aesd_circular_buffer_entry_at(&buffer, i, &entry_start);
+
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(position, entry_start, "entries follow each other");
+        for (size_t byte = 0; byte < entry->size; byte++, position++)
+        {
+            TEST_ASSERT_EQUAL_PTR_MESSAGE(entry, aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, position, &offset),
+                                          "entry holding the position");
+            TEST_ASSERT_EQUAL_UINT_MESSAGE(byte, offset, "byte of the entry");
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(buffer.total_size, position, "the entries cover total_size");
+}
+
+/**
+ * Single byte entries, where every position is the boundary of an entry
+ */
+void test_circular_buffer_search_single_bytes()
+{
+    struct aesd_circular_buffer buffer;
+    struct aesd_buffer_entry entry;
+    size_t offset = 0;
+    static const char bytes[] = "0123456789ABCDEF";
+
+    aesd_circular_buffer_init(&buffer);
+    for (int i = 0; i < 16; i++)
+    {
+        entry.buffptr = &bytes[i];
+        entry.size = 1;
+        aesd_circular_buffer_add_entry(&buffer, &entry);
+    }
+    for (size_t position = 0; position < AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED; position++)
+    {
+        struct aesd_buffer_entry *found = aesd_circular_buffer_find_entry_offset_for_fpos(&buffer, position, &offset);
+
+        TEST_ASSERT_NOT_NULL_MESSAGE(found, "every held position is found");
+        TEST_ASSERT_EQUAL_PTR_MESSAGE(&bytes[16 - AESDCHAR_MAX_WRITE_OPERATIONS_SUPPORTED + position], found->buffptr,
+                                      "the entry of the position");
+        TEST_ASSERT_EQUAL_UINT_MESSAGE(0, offset, "an entry has a single byte");
+    }
+}